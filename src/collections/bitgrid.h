@@ -0,0 +1,56 @@
+#ifndef BITGRID_H
+#define BITGRID_H
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+// A fixed size grid of flags packed one bit per cell. Rows are padded out to
+// whole 64 bit words so that a row can be scanned a word at a time. Copies of
+// a grid share its words until one of them writes, which copies them first.
+template <int Rows, int Cols>
+class BitGrid {
+    public:
+        static const int ROW_WORDS = (Cols + 63) / 64;
+    private:
+        typedef struct {
+            uint64_t words[Rows][ROW_WORDS];
+        } Words;
+
+        std::shared_ptr<Words> bits;
+
+        Words& own() {
+            if (bits.use_count() > 1) {
+                bits = std::make_shared<Words>(*bits);
+            }
+            return *bits;
+        }
+    public:
+        BitGrid() {
+            clear();
+        }
+        void clear() {
+            if (!bits || bits.use_count() > 1) {
+                bits = std::make_shared<Words>();
+            }
+            memset(bits->words, 0, sizeof(bits->words));
+        }
+        bool get(int row, int col) const {
+            return (bits->words[row][col / 64] >> (col % 64)) & 1;
+        }
+        void set(int row, int col) {
+            own().words[row][col / 64] |= (uint64_t)1 << (col % 64);
+        }
+        void reset(int row, int col) {
+            own().words[row][col / 64] &= ~((uint64_t)1 << (col % 64));
+        }
+        void assign(int row, int col, bool value) {
+            if (value) {
+                set(row, col);
+            } else {
+                reset(row, col);
+            }
+        }
+};
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef COW_H
+#define COW_H
+
+#include <memory>
+
+// A value that copies share until one of them writes to it through mut, which
+// duplicates it first if it is shared. Reads go through * and -> and never copy.
+template <typename T>
+class Cow {
+    std::shared_ptr<T> value;
+    public:
+        Cow(): value(std::make_shared<T>()) {}
+        const T& operator*() const {
+            return *value;
+        }
+        const T* operator->() const {
+            return value.get();
+        }
+        T& mut() {
+            if (value.use_count() > 1) {
+                value = std::make_shared<T>(*value);
+            }
+            return *value;
+        }
+};
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef COW_GRID_H
+#define COW_GRID_H
+
+#include <memory>
+
+// A fixed size grid stored as bands of ChunkRows rows. Copies of a grid share
+// their bands, so copying costs one pointer per band no matter how large the
+// cells are. A band is only duplicated when one of the sharing grids writes
+// to it through mut. Reads go through the const row accessor and never copy.
+template <typename T, int Rows, int Cols, int ChunkRows = 8>
+class CowGrid {
+    static_assert((ChunkRows & (ChunkRows - 1)) == 0, "ChunkRows must be a power of two");
+    static const int CHUNKS = (Rows + ChunkRows - 1) / ChunkRows;
+
+    typedef struct {
+        T cells[ChunkRows][Cols];
+    } Chunk;
+
+    std::shared_ptr<Chunk> chunks[CHUNKS];
+    public:
+        CowGrid() {
+            for(int i = 0; i < CHUNKS; i++) {
+                chunks[i] = std::make_shared<Chunk>();
+            }
+        }
+        // the cells of a row, for reading
+        const T* operator[](int row) const {
+            return chunks[row / ChunkRows]->cells[row % ChunkRows];
+        }
+        // a cell for writing, its band is duplicated first if another grid shares it
+        T& mut(int row, int col) {
+            std::shared_ptr<Chunk>& chunk = chunks[row / ChunkRows];
+            if (chunk.use_count() > 1) {
+                chunk = std::make_shared<Chunk>(*chunk);
+            }
+            return chunk->cells[row % ChunkRows][col];
+        }
+        void fill(const T& value) {
+            for(int i = 0; i < CHUNKS; i++) {
+                if (chunks[i].use_count() > 1) {
+                    chunks[i] = std::make_shared<Chunk>();
+                }
+                for(int row = 0; row < ChunkRows; row++) {
+                    for(int col = 0; col < Cols; col++) {
+                        chunks[i]->cells[row][col] = value;
+                    }
+                }
+            }
+        }
+};
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef COW_POOL_H
+#define COW_POOL_H
+
+#include <vector>
+#include <memory>
+
+// A growable array stored contiguously in chunks of ChunkSize items. As with
+// CowGrid, copies of a pool share their chunks, and a chunk is only duplicated
+// when one of the sharing pools writes to it through mut or add. Items never
+// move while their chunk is held, so a pointer from mut stays valid as the
+// pool grows. A pointer from the const accessor may be left on the old chunk
+// once the item's chunk is duplicated by a write.
+template <typename T, int ChunkSize = 64>
+class CowPool {
+    // the items vector is reserved up front so adding never reallocates it
+    struct Chunk {
+        std::vector<T> items;
+        Chunk() {
+            items.reserve(ChunkSize);
+        }
+        Chunk(const Chunk& other) {
+            items.reserve(ChunkSize);
+            items.insert(items.end(), other.items.begin(), other.items.end());
+        }
+    };
+
+    std::vector<std::shared_ptr<Chunk>> chunks;
+    size_t count = 0;
+
+    Chunk& own(size_t chunk) {
+        if (chunks[chunk].use_count() > 1) {
+            chunks[chunk] = std::make_shared<Chunk>(*chunks[chunk]);
+        }
+        return *chunks[chunk];
+    }
+    public:
+        size_t size() const {
+            return count;
+        }
+        // an item for reading
+        const T& operator[](size_t i) const {
+            return chunks[i / ChunkSize]->items[i % ChunkSize];
+        }
+        // an item for writing, its chunk is duplicated first if another pool shares it
+        T& mut(size_t i) {
+            return own(i / ChunkSize).items[i % ChunkSize];
+        }
+        // append an item, returning its position
+        size_t add(const T& item) {
+            if (count % ChunkSize == 0) {
+                chunks.push_back(std::make_shared<Chunk>());
+            }
+            own(count / ChunkSize).items.push_back(item);
+            return count++;
+        }
+};
+
+#endif
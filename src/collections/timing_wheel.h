@@ -0,0 +1,88 @@
+#ifndef TIMING_WHEEL_H
+#define TIMING_WHEEL_H
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+// A priority queue for items keyed by an int turn member, for schedules where
+// nothing is ever queued Slots or more turns past the earliest queued item.
+// Every pending turn then owns its own slot in a ring, so push and pop are
+// constant time and never compare items. Items on the same turn come out in
+// the order they went in.
+template <typename T, int Slots = 1024>
+class TimingWheel {
+    static_assert((Slots & (Slots - 1)) == 0, "Slots must be a power of two");
+    static const int WORDS = Slots / 64;
+
+    std::vector<T> slots[Slots];
+    // index of the next item to pop in each slot
+    size_t heads[Slots];
+    // one bit per slot that holds items
+    uint64_t occupied[WORDS];
+    size_t count;
+    // the turn of the slot that pop reads first
+    int now;
+
+    int _next_slot() const {
+        int start = now & (Slots - 1);
+        int word = start / 64;
+        uint64_t bits = occupied[word] & (~(uint64_t)0 << (start % 64));
+        for(int i = 0; i <= WORDS; i++) {
+            if (bits != 0) {
+                return word * 64 + __builtin_ctzll(bits);
+            }
+            word = (word + 1) % WORDS;
+            bits = occupied[word];
+        }
+        return -1;
+    }
+    public:
+        TimingWheel() {
+            clear();
+        }
+        void push(T item) {
+            assert(item.turn >= now && item.turn - now < Slots);
+            int slot = item.turn & (Slots - 1);
+            slots[slot].push_back(item);
+            occupied[slot / 64] |= (uint64_t)1 << (slot % 64);
+            count++;
+        }
+        // the earliest item, which must exist
+        const T& peek() const {
+            assert(count > 0);
+            int slot = _next_slot();
+            return slots[slot][heads[slot]];
+        }
+        T pop() {
+            assert(count > 0);
+            int slot = _next_slot();
+            T ret = slots[slot][heads[slot]];
+            now = ret.turn;
+            heads[slot]++;
+            count--;
+
+            if (heads[slot] == slots[slot].size()) {
+                slots[slot].clear();
+                heads[slot] = 0;
+                occupied[slot / 64] &= ~((uint64_t)1 << (slot % 64));
+            }
+            return ret;
+        }
+        bool is_empty() const {
+            return count == 0;
+        }
+        void clear() {
+            for(int i = 0; i < Slots; i++) {
+                slots[i].clear();
+                heads[i] = 0;
+            }
+            for(int i = 0; i < WORDS; i++) {
+                occupied[i] = 0;
+            }
+            count = 0;
+            now = 0;
+        }
+};
+
+#endif
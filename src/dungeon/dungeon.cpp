@@ -1,37 +1,60 @@
 #include <vector>
 #include <algorithm>
 #include <climits>
+#include <cstring>
 
 #include <dungeon/dungeon.h>
 #include <io.h>
 #include <util/util.h>
 
+// phases of generation that draw keyed random numbers, see keyed_rand
+enum {
+    PHASE_NOISE,
+    PHASE_VEIN_START,
+    PHASE_VEIN_HARDNESS,
+    PHASE_VEIN_WALK
+};
+
 static void _generate_veins(Dungeon *dungeon, int hardness, int liklihood);
+static void _create_vein(Dungeon *dungeon, uint8_t veins[][DUNGEON_WIDTH], int hardness, int row, int col);
 static void _generate_maze(Dungeon *dungeon, int windiness, int max_maze_size);
 static bool _can_place_room(Dungeon *dungeon, DungeonRoom *room, int col, int row);
 static void _place_room(Dungeon *dungeon, DungeonRoom *room, int col, int row);
 static void _fill_maze(Dungeon *dungeon);
 static void _unfreeze_rooms(Dungeon *dungeon);
 
-void rebuild_dungeon(Dungeon *dungeon) {
-    delete dungeon->store;
-    delete dungeon->o_store;
-    *dungeon = create_dungeon(dungeon->params);
+Dungeon Dungeon::clone() const {
+    Dungeon copy = *this;
+    copy.store = std::make_shared<EntityStore>(*store);
+    return copy;
 }
 
 void destroy_dungeon(Dungeon *dungeon) {
-    delete dungeon->store;
-    delete dungeon->o_store;
+    dungeon->store.reset();
+    dungeon->o_store.reset();
+}
+
+std::shared_ptr<ObjectStore> create_object_store(Options *params) {
+    std::shared_ptr<ObjectStore> o_store = std::make_shared<ObjectStore>();
+    for(size_t i = 0; i < params->object_pool.size(); i++) {
+        auto object = params->object_pool[i].generate();
+        o_store->add_object(object);
+    }
+    return o_store;
 }
 
-Dungeon create_dungeon(Options* params) {
+Dungeon create_dungeon(Options* params, std::shared_ptr<ObjectStore> o_store) {
     Dungeon dungeon;
     dungeon.regions = 0;
-    dungeon.store = new EntityStore();
-    dungeon.o_store = new ObjectStore();
+    dungeon.store = std::make_shared<EntityStore>();
+    dungeon.o_store = o_store;
     dungeon.monster_count = params->monsters;
     dungeon.params = params;
+    dungeon.seed = rng_streams[RNG_DUNGEON].next();
     // fill dungeon with random noise
+    dungeon.room.fill(0);
+    dungeon.entities.fill(0);
+    dungeon.objects.fill(0);
     for(int row = 0; row < DUNGEON_HEIGHT; row++) {
         for(int col = 0; col < DUNGEON_WIDTH; col++) {
             uint8_t hardness;
@@ -41,12 +64,14 @@ Dungeon create_dungeon(Options* params) {
                 hardness = HARDNESS_TIER_MAX;
                 immutable = true;
             } else {
-                hardness = better_rand((HARDNESS_TIER_3 - HARDNESS_TIER_1) - 1) + HARDNESS_TIER_1;
+                hardness = keyed_rand(dungeon.seed, PHASE_NOISE, row, col, (HARDNESS_TIER_3 - HARDNESS_TIER_1) - 1) + HARDNESS_TIER_1;
                 immutable = false;
             }
 
-            DungeonBlock block = {.type = DungeonBlock::ROCK, .hardness = hardness, .region = 0, .immutable = immutable, .entity_id = 0, .object_id = 0};
-            dungeon.blocks[row][col] = block;
+            dungeon.type.mut(row, col) = DungeonBlock::ROCK;
+            dungeon.hardness.mut(row, col) = hardness;
+            dungeon.region.mut(row, col) = 0;
+            dungeon.immutable.assign(row, col, immutable);
         }
     }
 
@@ -90,34 +115,28 @@ Dungeon create_dungeon(Options* params) {
         int row = better_rand(DUNGEON_HEIGHT - 1);
         int col = better_rand(DUNGEON_WIDTH - 1);
 
-        if (dungeon.blocks[row][col].type != DungeonBlock::ROCK &&
-            dungeon.blocks[row][col].type != DungeonBlock::PILLAR &&
-            dungeon.blocks[row][col].entity_id == 0) {
+        if (dungeon.type[row][col] != DungeonBlock::ROCK &&
+            dungeon.type[row][col] != DungeonBlock::PILLAR &&
+            dungeon.entities[row][col] == 0) {
             
             MonsterDescription& desc = params->monster_pool[better_rand(params->monster_pool.size() - 1)];
             EIdx id = dungeon.store->spawn_monster(desc, row, col);
-            dungeon.blocks[row][col].entity_id = id;
+            dungeon.entities.mut(row, col) = id;
             monsters_to_place--;
         }
     }
 
-    // the object store will be universal across floors, since objects are essentially immutable.
-    for(size_t i = 0; i < params->object_pool.size(); i++) {
-        auto object = params->object_pool[i].generate();
-        dungeon.o_store->add_object(object);
-    }
-
     int objects_to_place = 20;
     while(objects_to_place > 0 && params->object_pool.size() > 0) {
         int row = better_rand(DUNGEON_HEIGHT - 1);
         int col = better_rand(DUNGEON_WIDTH - 1);
 
-        if (dungeon.blocks[row][col].type != DungeonBlock::ROCK &&
-            dungeon.blocks[row][col].type != DungeonBlock::PILLAR &&
-            dungeon.blocks[row][col].object_id == 0) {
+        if (dungeon.type[row][col] != DungeonBlock::ROCK &&
+            dungeon.type[row][col] != DungeonBlock::PILLAR &&
+            dungeon.objects[row][col] == 0) {
             
             OIdx id = better_rand(dungeon.o_store->size() - 1) + 1;
-            dungeon.blocks[row][col].object_id = id;
+            dungeon.objects.mut(row, col) = id;
             objects_to_place--;
         }
     }
@@ -132,17 +151,19 @@ Dungeon create_dungeon(Options* params) {
 
     _fill_maze(&dungeon);
 
+    index_terrain(&dungeon);
+
     //place the player
     while(1) {
         int row = better_rand(DUNGEON_HEIGHT - 1);
         int col = better_rand(DUNGEON_WIDTH - 1);
 
-        if (dungeon.blocks[row][col].type != DungeonBlock::ROCK &&
-            dungeon.blocks[row][col].type != DungeonBlock::PILLAR &&
-            dungeon.blocks[row][col].entity_id == 0) {
+        if (dungeon.type[row][col] != DungeonBlock::ROCK &&
+            dungeon.type[row][col] != DungeonBlock::PILLAR &&
+            dungeon.entities[row][col] == 0) {
 
             EIdx player_id = dungeon.store->spawn_player(row, col);
-            dungeon.blocks[row][col].entity_id = player_id;
+            dungeon.entities.mut(row, col) = player_id;
             dungeon.player_id = player_id;
             break;
         }
@@ -153,8 +174,8 @@ Dungeon create_dungeon(Options* params) {
         int row = better_rand(DUNGEON_HEIGHT - 1);
         int col = better_rand(DUNGEON_WIDTH - 1);
 
-        if (dungeon.blocks[row][col].type == DungeonBlock::FLOOR) {
-            dungeon.blocks[row][col].type = DungeonBlock::UPSTAIRS;
+        if (dungeon.type[row][col] == DungeonBlock::FLOOR) {
+            dungeon.type.mut(row, col) = DungeonBlock::UPSTAIRS;
             break;
         }
     }
@@ -163,26 +184,32 @@ Dungeon create_dungeon(Options* params) {
         int row = better_rand(DUNGEON_HEIGHT - 1);
         int col = better_rand(DUNGEON_WIDTH - 1);
 
-        if (dungeon.blocks[row][col].type == DungeonBlock::FLOOR) {
-            dungeon.blocks[row][col].type = DungeonBlock::DOWNSTAIRS;
+        if (dungeon.type[row][col] == DungeonBlock::FLOOR) {
+            dungeon.type.mut(row, col) = DungeonBlock::DOWNSTAIRS;
             break;
         }
     }
     return dungeon;
 }
 
-static void _create_vein(Dungeon *dungeon, int hardness, int row, int col) {
+// Walk a vein from (row, col), marking its blocks in veins. Each vein walks
+// with its own generator keyed by where it starts, and only reads the
+// immutable flags, which veins never change. Where veins cross the harder one
+// wins, so the result is the same whatever order the veins are walked in.
+static void _create_vein(Dungeon *dungeon, uint8_t veins[][DUNGEON_WIDTH], int hardness, int row, int col) {
     if (row % 2 != 0 || col % 2 != 0) {
         return;
     }
 
-    int last_direction = better_rand(3);
+    Rng rng;
+    rng.seed(keyed_rand(dungeon->seed, PHASE_VEIN_WALK, row, col));
+    int last_direction = rng.bounded(4);
 
-    while(better_rand(99) < 98) {
-        if (dungeon->blocks[row][col].immutable) {
+    while(rng.bounded(100) < 98) {
+        if (dungeon->immutable.get(row, col)) {
             break;
         }
-        dungeon->blocks[row][col].hardness = hardness;
+        veins[row][col] = std::max(veins[row][col], (uint8_t)hardness);
 
         relative_array(1, row, col, DUNGEON_HEIGHT, DUNGEON_WIDTH, );
         relative_array(2, row, col, DUNGEON_HEIGHT, DUNGEON_WIDTH, _extra);
@@ -194,19 +221,18 @@ static void _create_vein(Dungeon *dungeon, int hardness, int row, int col) {
         
         bool can_grow[4] = {false, false, false, false};
         for (int i = 0; i < 4; i++) {
-            DungeonBlock block_a = dungeon->blocks[adjacent[i][0][0]][adjacent[i][0][1]];
-            DungeonBlock block_b = dungeon->blocks[adjacent[i][1][0]][adjacent[i][1][1]];
-            if(!block_a.immutable && !block_b.immutable) {
+            if(!dungeon->immutable.get(adjacent[i][0][0], adjacent[i][0][1]) &&
+               !dungeon->immutable.get(adjacent[i][1][0], adjacent[i][1][1])) {
                 can_grow[i] = true;
             }
         }
 
         int next_dir;
-        if (better_rand(100) > 10) {
+        if (rng.bounded(101) > 10) {
             next_dir = last_direction;
         } else {
             do {
-                next_dir = better_rand(3);
+                next_dir = rng.bounded(4);
             } while(!can_grow[next_dir]);
         }
 
@@ -215,8 +241,8 @@ static void _create_vein(Dungeon *dungeon, int hardness, int row, int col) {
         int row_b = adjacent[next_dir][1][0];
         int col_b = adjacent[next_dir][1][1];
 
-        dungeon->blocks[row_a][col_a].hardness = hardness;
-        dungeon->blocks[row_b][col_b].hardness = hardness;
+        veins[row_a][col_a] = std::max(veins[row_a][col_a], (uint8_t)hardness);
+        veins[row_b][col_b] = std::max(veins[row_b][col_b], (uint8_t)hardness);
         row = row_b;
         col = col_b;
         last_direction = next_dir;
@@ -224,17 +250,29 @@ static void _create_vein(Dungeon *dungeon, int hardness, int row, int col) {
 }
 
 static void _generate_veins(Dungeon *dungeon, int hardness, int likelihood) {
-    
+    // the hardness each block takes from veins, 0 where there are none
+    uint8_t veins[DUNGEON_HEIGHT][DUNGEON_WIDTH];
+    memset(veins, 0, sizeof(veins));
+
+    // the hardness of a vein is only drawn where one starts
     for(int row = 2; row < DUNGEON_HEIGHT; row += 2) {
         for(int col = 2; col < DUNGEON_WIDTH; col += 2) {
-            if (dungeon->blocks[row][col].immutable || better_rand(likelihood) != 0) {
+            if (dungeon->immutable.get(row, col) || keyed_rand(dungeon->seed, PHASE_VEIN_START, row, col, likelihood) != 0) {
                 continue;
             }
 
-            if (better_rand(99) < hardness) {
-                _create_vein(dungeon, HARDNESS_TIER_3, row, col);
+            if (keyed_rand(dungeon->seed, PHASE_VEIN_HARDNESS, row, col, 99) < hardness) {
+                _create_vein(dungeon, veins, HARDNESS_TIER_3, row, col);
             } else {
-                _create_vein(dungeon, HARDNESS_TIER_0 + 1, row, col);
+                _create_vein(dungeon, veins, HARDNESS_TIER_0 + 1, row, col);
+            }
+        }
+    }
+
+    for(int row = 0; row < DUNGEON_HEIGHT; row++) {
+        for(int col = 0; col < DUNGEON_WIDTH; col++) {
+            if (veins[row][col] != 0) {
+                dungeon->hardness.mut(row, col) = veins[row][col];
             }
         }
     }
@@ -254,8 +292,8 @@ static bool _can_place_room(Dungeon *dungeon, DungeonRoom *room, int col, int ro
         for (col = dungeon_col_start; col < dungeon_col_end; col++) {
             int room_row = row - dungeon_row_start + room->start_row;
             int room_col = col - dungeon_col_start + room->start_col;
-            if (dungeon->blocks[row][col].type != DungeonBlock::ROCK || dungeon->blocks[row][col].immutable || 
-            dungeon->blocks[row][col].hardness >= HARDNESS_TIER_3 || dungeon->blocks[row][col].hardness < HARDNESS_TIER_1) {
+            if (dungeon->type[row][col] != DungeonBlock::ROCK || dungeon->immutable.get(row, col) || 
+            dungeon->hardness[row][col] >= HARDNESS_TIER_3 || dungeon->hardness[row][col] < HARDNESS_TIER_1) {
                 return false;
             }
 
@@ -288,13 +326,16 @@ static void _place_room(Dungeon *dungeon, DungeonRoom *room, int col, int row) {
         for (col = dungeon_col_start; col < dungeon_col_end; col++) {
             int room_row = row - dungeon_row_start + room->start_row;
             int room_col = col - dungeon_col_start + room->start_col;
-            dungeon->blocks[row][col].type = room->blocks[room_row][room_col].type;
-            dungeon->blocks[row][col].region = dungeon->regions;
+            dungeon->type.mut(row, col) = room->blocks[room_row][room_col].type;
+            dungeon->region.mut(row, col) = dungeon->regions;
+            if (room->blocks[room_row][room_col].type != DungeonBlock::ROCK) {
+                dungeon->room.mut(row, col) = dungeon->regions;
+            }
 
             // room blocks are immutable to prevent mazes pathing into their area
             if (row != dungeon_row_start && row != dungeon_row_end
                 && col != dungeon_col_start && col != dungeon_col_end) {
-                dungeon->blocks[row][col].immutable = true;
+                dungeon->immutable.assign(row, col, true);
             }  
         }
     }
@@ -308,22 +349,25 @@ static void _generate_maze(Dungeon *dungeon, int windiness, int max_maze_size) {
 
     for (int row = 1; row < DUNGEON_HEIGHT; row += 2) {
         for (int col = 1; col < DUNGEON_WIDTH; col += 2) {
-            if (dungeon->blocks[row][col].type != DungeonBlock::ROCK || dungeon->blocks[row][col].immutable || 
-            dungeon->blocks[row][col].hardness >= HARDNESS_TIER_3 || dungeon->blocks[row][col].hardness < HARDNESS_TIER_1) {
+            if (dungeon->type[row][col] != DungeonBlock::ROCK || dungeon->immutable.get(row, col) || 
+            dungeon->hardness[row][col] >= HARDNESS_TIER_3 || dungeon->hardness[row][col] < HARDNESS_TIER_1) {
                 continue;
             }
 
             dungeon->regions++;
             // carve this section of the maze
             std::vector<Coord> carved_list;
-            dungeon->blocks[row][col].type = DungeonBlock::HALL;
-            dungeon->blocks[row][col].region = dungeon->regions;
+            dungeon->type.mut(row, col) = DungeonBlock::HALL;
+            dungeon->region.mut(row, col) = dungeon->regions;
 
             carved_list.push_back((Coord){.row = row, .col = col});
 
             int maze_size = 0;
             while(carved_list.size() > 0 && maze_size++ < max_maze_size) {
-                std::random_shuffle(carved_list.begin(), carved_list.end());
+                // shuffle with better_rand so mazes follow the seed
+                for(size_t i = carved_list.size() - 1; i > 0; i--) {
+                    std::swap(carved_list[i], carved_list[better_rand(i)]);
+                }
                 Coord coord = carved_list.back();
                 carved_list.pop_back();
                 // decompose the coordinate
@@ -345,9 +389,8 @@ static void _generate_maze(Dungeon *dungeon, int windiness, int max_maze_size) {
                 int carved_index = 0;
                 int total_carved = 0;
                 for (int i = 0; i < 4; i++) {
-                    DungeonBlock block_a = dungeon->blocks[adjacent[i][0][0]][adjacent[i][0][1]];
-                    DungeonBlock block_b = dungeon->blocks[adjacent[i][1][0]][adjacent[i][1][1]];
-                    if(block_a.type != DungeonBlock::ROCK && block_b.type != DungeonBlock::ROCK) {
+                    if(dungeon->type[adjacent[i][0][0]][adjacent[i][0][1]] != DungeonBlock::ROCK &&
+                       dungeon->type[adjacent[i][1][0]][adjacent[i][1][1]] != DungeonBlock::ROCK) {
                         total_carved++;
                         carved_index = i;
                     }
@@ -365,12 +408,16 @@ static void _generate_maze(Dungeon *dungeon, int windiness, int max_maze_size) {
                 int lowest_weight_index = -1;
                 bool can_carve[4] = {false, false, false, false};
                 for (int i = 0; i < 4; i++) {
-                    DungeonBlock block_a = dungeon->blocks[adjacent[i][0][0]][adjacent[i][0][1]];
-                    DungeonBlock block_b = dungeon->blocks[adjacent[i][1][0]][adjacent[i][1][1]];
-                    if((!block_a.immutable && block_a.type == DungeonBlock::ROCK && block_a.hardness < HARDNESS_TIER_3 && block_a.hardness >= HARDNESS_TIER_1) && 
-                    (!block_b.immutable && block_b.type == DungeonBlock::ROCK && block_b.hardness < HARDNESS_TIER_3 && block_a.hardness >= HARDNESS_TIER_1)) {
+                    int row_a = adjacent[i][0][0];
+                    int col_a = adjacent[i][0][1];
+                    int row_b = adjacent[i][1][0];
+                    int col_b = adjacent[i][1][1];
+                    uint8_t hardness_a = dungeon->hardness[row_a][col_a];
+                    uint8_t hardness_b = dungeon->hardness[row_b][col_b];
+                    if((!dungeon->immutable.get(row_a, col_a) && dungeon->type[row_a][col_a] == DungeonBlock::ROCK && hardness_a < HARDNESS_TIER_3 && hardness_a >= HARDNESS_TIER_1) && 
+                    (!dungeon->immutable.get(row_b, col_b) && dungeon->type[row_b][col_b] == DungeonBlock::ROCK && hardness_b < HARDNESS_TIER_3 && hardness_a >= HARDNESS_TIER_1)) {
                         can_carve[i] = true;
-                        int weight = block_a.hardness + block_b.hardness;
+                        int weight = hardness_a + hardness_b;
                         if (i == last_dir) {
                             weight -= 1;;
                         }
@@ -401,10 +448,10 @@ static void _generate_maze(Dungeon *dungeon, int windiness, int max_maze_size) {
                 int row_b = adjacent[next_dir][1][0];
                 int col_b = adjacent[next_dir][1][1];
 
-                dungeon->blocks[row_a][col_a].type = DungeonBlock::HALL;
-                dungeon->blocks[row_b][col_b].type = DungeonBlock::HALL;
-                dungeon->blocks[row_a][col_a].region = dungeon->regions;
-                dungeon->blocks[row_b][col_b].region = dungeon->regions;
+                dungeon->type.mut(row_a, col_a) = DungeonBlock::HALL;
+                dungeon->type.mut(row_b, col_b) = DungeonBlock::HALL;
+                dungeon->region.mut(row_a, col_a) = dungeon->regions;
+                dungeon->region.mut(row_b, col_b) = dungeon->regions;
 
                 carved_list.push_back(coord);
                 carved_list.push_back((Coord){.row = row_b, .col = col_b});
@@ -428,7 +475,7 @@ static void _fill_maze_helper(Dungeon *dungeon, int row, int col) {
                                 {row, left}};
     
     for (int i = 0; i < 4; i++) {
-        if (dungeon->blocks[adjacent[i][0]][adjacent[i][1]].type != DungeonBlock::ROCK) {
+        if (dungeon->type[adjacent[i][0]][adjacent[i][1]] != DungeonBlock::ROCK) {
             total_open++;
             last_open_row = adjacent[i][0];
             last_open_col = adjacent[i][1];
@@ -436,12 +483,12 @@ static void _fill_maze_helper(Dungeon *dungeon, int row, int col) {
     }
 
     if (total_open == 1) {
-        dungeon->blocks[row][col].type = DungeonBlock::ROCK;
+        dungeon->type.mut(row, col) = DungeonBlock::ROCK;
         _fill_maze_helper(dungeon, last_open_row, last_open_col);
     }
 
     if (total_open == 0) {
-         dungeon->blocks[row][col].type = DungeonBlock::ROCK;
+         dungeon->type.mut(row, col) = DungeonBlock::ROCK;
     }
 }
 
@@ -456,7 +503,7 @@ static void _fill_maze(Dungeon *dungeon) {
 static void _unfreeze_rooms(Dungeon *dungeon) {
     for(int row = 1; row < DUNGEON_HEIGHT - 1; row++) {
         for(int col = 1; col < DUNGEON_WIDTH - 1; col++) {
-            dungeon->blocks[row][col].immutable = false;
+            dungeon->immutable.assign(row, col, false);
         }
     }
 }
\ No newline at end of file
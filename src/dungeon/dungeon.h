@@ -2,7 +2,10 @@
 #define DUNGEON_H
 
 #include <vector>
+#include <memory>
 
+#include <collections/bitgrid.h>
+#include <collections/cow_grid.h>
 #include <dungeon/entities.h>
 #include <dungeon/object.h>
 
@@ -25,6 +28,16 @@ class Options {
     int load;
     char path[256];
     int full_size;
+    int animate;
+    int ai_threads;
+    // microseconds of monster path searching per player turn, 0 for no limit
+    // and -1 for the default
+    int ai_budget;
+    // games to play headless with the bot, 0 to play normally
+    int soak_games;
+    int soak_workers;
+    // seeds the random streams, and the first soak game
+    uint64_t seed;
     int monsters;
     int room_tries;
     int min_rooms;
@@ -44,11 +57,6 @@ typedef struct {
         UPSTAIRS,
         DOWNSTAIRS,
     } type;
-    uint8_t hardness;
-    int region;
-    bool immutable;
-    EIdx entity_id;
-    OIdx object_id;
 } DungeonBlock;
 
 typedef struct {
@@ -59,25 +67,78 @@ typedef struct {
     DungeonBlock blocks[27][27];
 } DungeonRoom;
 
-typedef struct {
+// one bit per neighbor that is not rock, rock is only drawn next to open space
+typedef CowGrid<uint8_t, 105, 160> OpenNeighbors;
+
+// A dungeon owns its grids, which live on the heap, and its stores. It can
+// only be moved, so handing a floor around costs a few pointers. A copy is
+// made with clone. The terrain is kept as one layer per field, so a scan over
+// the map only reads the layers it needs. Layers are read with
+// layer[row][col] and written with layer.mut(row, col).
+struct Dungeon {
     Options* params;
+    // keys the counter based random numbers drawn while generating
+    uint64_t seed;
     int regions;
     int monster_count;
     EIdx player_id;
-    EntityStore *store;
-    ObjectStore *o_store;
-    DungeonBlock blocks[105][160];
-} Dungeon;
+    std::shared_ptr<EntityStore> store;
+    std::shared_ptr<ObjectStore> o_store;
+    // a DungeonBlock::Type for every block
+    CowGrid<uint8_t, 105, 160> type;
+    CowGrid<uint8_t, 105, 160> hardness;
+    // the region each block was carved in, merged into one during generation
+    CowGrid<uint16_t, 105, 160> region;
+    // set for blocks generation may not carve into, the border and the rooms
+    BitGrid<105, 160> immutable;
+    // the index of the entity and object on each block, 0 for none. A block
+    // holds at most one of each, so the indices fit in 16 bits.
+    CowGrid<uint16_t, 105, 160> entities;
+    CowGrid<uint16_t, 105, 160> objects;
+    // the room each block belongs to, 0 outside of rooms. Regions are merged
+    // into one during generation, so rooms keep their own ids.
+    CowGrid<uint16_t, 105, 160> room;
+    // passability component of every block, 0 for blocks that cannot be walked on
+    int components;
+    CowGrid<uint16_t, 105, 160> component;
+    // set for every block that stops line of sight
+    BitGrid<105, 160> opaque;
+    OpenNeighbors open_neighbors;
+
+    Dungeon() = default;
+    Dungeon(Dungeon&& other) = default;
+    Dungeon& operator=(Dungeon&& other) = default;
+    // A copy that shares terrain bands and entities with this dungeon until
+    // either side writes to them. The copy gets its own entity list.
+    Dungeon clone() const;
+    private:
+        Dungeon(const Dungeon& other) = default;
+        Dungeon& operator=(const Dungeon& other) = default;
+        // a game snapshot copies its dungeon along with the rest of its state
+        friend class GameState;
+};
 
 // create a new random room with the given paramters. Rooms must be no larget than 25x25
 DungeonRoom create_room(int width, int height);
 
-Dungeon create_dungeon(Options *params);
+// Roll one object from every description. The store is shared by every floor
+// of a game, so the objects the player carries stay valid on the stairs.
+std::shared_ptr<ObjectStore> create_object_store(Options *params);
 
-void rebuild_dungeon(Dungeon *dungeon);
+// objects are placed from o_store, which is shared with the new dungeon and never written
+Dungeon create_dungeon(Options *params, std::shared_ptr<ObjectStore> o_store);
 
 void destroy_dungeon(Dungeon *dungeon);
 
 void merge_regions(Dungeon *dungeon, int extra_hole_chance);
 
+// rebuild the layers derived from terrain after the blocks are filled in
+void index_terrain(Dungeon *dungeon);
+
+// turn a block into a hall, keeping the derived terrain layers up to date
+void carve_block(Dungeon *dungeon, int row, int col);
+
+// record in the neighbors of (row, col) whether it is open, that is not rock
+void set_open_neighbor(OpenNeighbors& open_neighbors, int row, int col, bool open);
+
 #endif
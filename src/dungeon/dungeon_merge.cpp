@@ -58,12 +58,12 @@ void merge_regions(Dungeon *dungeon, int extra_hole_chance) {
             if (_make_connector(dungeon, &connector)) {
                 int col = connector.regions[0].col;
                 int row = connector.regions[0].row;
-                int region = dungeon->blocks[row][col].region;
+                int region = dungeon->region[row][col];
                 _list_push(&trackers[region - 1].list, connector);
                 
                 col = connector.regions[1].col;
                 row = connector.regions[1].row;
-                region = dungeon->blocks[row][col].region;
+                region = dungeon->region[row][col];
                 _list_push(&trackers[region - 1].list, connector);
             }
         }
@@ -83,11 +83,11 @@ void merge_regions(Dungeon *dungeon, int extra_hole_chance) {
             row_b = connector.regions[1].row;
             col_b = connector.regions[1].col;
 
-            if (dungeon->blocks[row_a][col_a].region != dungeon->blocks[row_b][col_b].region) {
-                int replacement = dungeon->blocks[row_a][col_a].region;
-                int target = dungeon->blocks[row_b][col_b].region;
-                dungeon->blocks[connector.row][connector.col].region = target;
-                dungeon->blocks[connector.row][connector.col].type = DungeonBlock::HALL;
+            if (dungeon->region[row_a][col_a] != dungeon->region[row_b][col_b]) {
+                int replacement = dungeon->region[row_a][col_a];
+                int target = dungeon->region[row_b][col_b];
+                dungeon->region.mut(connector.row, connector.col) = target;
+                dungeon->type.mut(connector.row, connector.col) = DungeonBlock::HALL;
                 
                 // flood fill the region to the same region, doesnt matter which one
                 _flood_fill(dungeon, connector.row, connector.col, target, replacement);
@@ -96,7 +96,7 @@ void merge_regions(Dungeon *dungeon, int extra_hole_chance) {
             }
 
             if (better_rand(extra_hole_chance) == 0) {
-                dungeon->blocks[connector.row][connector.col].type = DungeonBlock::HALL;
+                dungeon->type.mut(connector.row, connector.col) = DungeonBlock::HALL;
             }
         }
     }
@@ -113,7 +113,7 @@ static bool _make_connector(Dungeon *dungeon, Connector *connector) {
     int col = connector->col;
     int row = connector->row;
 
-    if (dungeon->blocks[row][col].type != DungeonBlock::ROCK) {
+    if (dungeon->type[row][col] != DungeonBlock::ROCK) {
         return false;
     }
 
@@ -127,14 +127,14 @@ static bool _make_connector(Dungeon *dungeon, Connector *connector) {
     int region_a = -1;
     int region_b = -1;
     for (int i = 0; i < 4; i++) {
-        DungeonBlock block = dungeon->blocks[adjacent[i][0]][adjacent[i][1]];
-        if (block.type != DungeonBlock::ROCK) {
+        int region = dungeon->region[adjacent[i][0]][adjacent[i][1]];
+        if (dungeon->type[adjacent[i][0]][adjacent[i][1]] != DungeonBlock::ROCK) {
             if (region_a == -1) {
-                region_a = block.region;
+                region_a = region;
                 connector->regions[0].row = adjacent[i][0];
                 connector->regions[0].col = adjacent[i][1];
-            } else if (block.region != region_a) {
-                region_b = block.region;
+            } else if (region != region_a) {
+                region_b = region;
                 connector->regions[1].row = adjacent[i][0];
                 connector->regions[1].col = adjacent[i][1];
             }
@@ -195,11 +195,11 @@ static void _flood_fill(Dungeon *dungeon, int row, int col, int target, int repl
         return;
     }
 
-    if (dungeon->blocks[row][col].region != target) {
+    if (dungeon->region[row][col] != target) {
         return;
     }
 
-    dungeon->blocks[row][col].region = replacement;
+    dungeon->region.mut(row, col) = replacement;
 
     relative_array(1, row, col, DUNGEON_HEIGHT, DUNGEON_WIDTH, );
 
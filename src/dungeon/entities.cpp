@@ -5,17 +5,20 @@
 #include <util/util.h>
 #include <cstdio>
 
-Entity::Entity(int row, int col) {
+Entity::Entity(Kind kind, int row, int col) {
+    this->kind = kind;
     this->row = row;
     this->col = col;
     this->alive = true;
     this->print = 'U';
 }
 
-Monster::Monster(int row, int col): Entity::Entity(row, col) {
+Monster::Monster(int row, int col): Entity::Entity(MONSTER, row, col) {
     speed = better_rand(15) + 5;
     pc_last_seen[0] = row;
     pc_last_seen[1] = col;  
+    wake_turn = 0;
+    last_step = -1;
     smart = better_rand(1);
     telepathic = better_rand(1);
     tunneling = better_rand(1);
@@ -33,9 +36,7 @@ Monster::Monster(int row, int col): Entity::Entity(row, col) {
     }
 }
 
-void Entity::no_op() {}
-
-Player::Player(int row, int col): Entity::Entity(row, col) {
+Player::Player(int row, int col): Entity::Entity(PLAYER, row, col) {
     for(int i = 0; i < 10; i++) {
         carry[i] = 0;
     }
@@ -46,66 +47,77 @@ Player::Player(int row, int col): Entity::Entity(row, col) {
     base_damage.parse_str("0+1d4");
     speed = 10;
     print = '@';
+
+    // nothing is equipped yet
+    stats.speed = speed;
+    stats.defense = 0;
+    stats.damage.add(base_damage);
 }
 
-template <typename E>
-EIdx EntityStore::add_entity(E entity) {
-    entity.index = list.size() + 1;
-    list.push_back(std::make_unique<E>(entity));
-    return entity.index;
+void Player::update_stats(ObjectStore *store) {
+    stats.speed = speed;
+    stats.defense = 0;
+    stats.damage = DicePool();
+
+    if (equipment[0] == 0) {
+        // no weapon, do base damage
+        stats.damage.add(base_damage);
+    }
+    for(int i = 0; i < 12; i++) {
+        if (equipment[i] != 0) {
+            Object *obj = store->get(equipment[i]).unwrap();
+            stats.speed += obj->speed_bonus;
+            stats.defense += obj->defense_bonus;
+            stats.damage.add(obj->damage_bonus);
+        }
+    }
 }
 
 EIdx EntityStore::spawn_player(int row, int col) {
     Player player(row, col);
-    EIdx j = add_entity(player);
-    return j;
+    player.index = slots.size() + 1;
+    slots.push_back((Slot){.kind = Entity::PLAYER, .slot = (uint32_t)players.add(player)});
+    return player.index;
 }
 
 EIdx EntityStore::spawn_monster(MonsterDescription& desc, int row, int col) {
-    Monster monster(row, col);
-    monster.print = desc.symbol;
-    monster.speed = desc.speed.roll();
-    monster.smart = desc.smart;
-    monster.telepathic = desc.telepathic;
-    monster.tunneling = desc.tunneling;
-    monster.erratic = desc.erratic;
-    monster.hp = desc.hp.roll();
-    monster.damage = desc.damage;
-    monster.index = list.size() + 1;
-
-    if (desc.color.compare("RED") == 0) {
-        monster.color =  10;
-    } else if (desc.color.compare("GREEN") == 0) {
-        monster.color =  11;
-    } else if (desc.color.compare("BLUE") == 0) {
-        monster.color =  12;
-    } else if (desc.color.compare("CYAN") == 0) {
-        monster.color =  13;
-    } else if (desc.color.compare("YELLOW") == 0) {
-        monster.color =  14;
-    } else if (desc.color.compare("MAGENTA") == 0) {
-        monster.color =  15;
-    } else if (desc.color.compare("WHITE") == 0) {
-        monster.color =  16;
-    } else if (desc.color.compare("BLACK") == 0) {
-        monster.color =  17;
-    } else {
-        monster.color =  3;
-    }
-    list.push_back(std::make_unique<Monster>(monster));
+    Monster monster = desc.generate(row, col);
+    monster.index = slots.size() + 1;
+    monster_traits.add(desc.traits());
+    slots.push_back((Slot){.kind = Entity::MONSTER, .slot = (uint32_t)monsters.add(monster)});
     return monster.index;
 }
 
-size_t EntityStore::size() {
-    return list.size();
+size_t EntityStore::size() const {
+    return slots.size();
 }
 
 Result<Entity *, Unit> EntityStore::get(EIdx index) {
-    if (index > list.size()) {
+    if (index > slots.size()) {
         return Result<Entity *, Unit>(unit());
     }
 
-    return list[index - 1].get();
+    Slot slot = slots[index - 1];
+    if (slot.kind == Entity::PLAYER) {
+        return static_cast<Entity *>(&players.mut(slot.slot));
+    }
+    return static_cast<Entity *>(&monsters.mut(slot.slot));
+}
+
+Result<const Entity *, Unit> EntityStore::peek(EIdx index) const {
+    if (index > slots.size()) {
+        return Result<const Entity *, Unit>(unit());
+    }
+
+    Slot slot = slots[index - 1];
+    if (slot.kind == Entity::PLAYER) {
+        return static_cast<const Entity *>(&players[slot.slot]);
+    }
+    return static_cast<const Entity *>(&monsters[slot.slot]);
+}
+
+const MonsterTraits& EntityStore::traits(const Monster *monster) const {
+    return monster_traits[slots[monster->index - 1].slot];
 }
 
 MonsterDescription::MonsterDescription() {
@@ -160,30 +172,35 @@ Monster MonsterDescription::generate(int row, int col) {
     monster.tunneling = tunneling;
     monster.erratic = erratic;
     monster.hp = hp.roll();
-    monster.damage = damage;
+    return monster;
+}
+
+MonsterTraits MonsterDescription::traits() {
+    MonsterTraits traits;
+    traits.damage = damage;
 
     if (color.compare("RED") == 0) {
-        monster.color =  10;
+        traits.color =  10;
     } else if (color.compare("GREEN") == 0) {
-        monster.color =  11;
+        traits.color =  11;
     } else if (color.compare("BLUE") == 0) {
-        monster.color =  12;
+        traits.color =  12;
     } else if (color.compare("CYAN") == 0) {
-        monster.color =  13;
+        traits.color =  13;
     } else if (color.compare("YELLOW") == 0) {
-        monster.color =  14;
+        traits.color =  14;
     } else if (color.compare("MAGENTA") == 0) {
-        monster.color =  15;
+        traits.color =  15;
     } else if (color.compare("WHITE") == 0) {
-        monster.color =  16;
+        traits.color =  16;
     } else if (color.compare("BLACK") == 0) {
-        monster.color =  17;
+        traits.color =  17;
     } else {
-        monster.color =  3;
+        traits.color =  3;
     }
-    return monster;
+    return traits;
 }
 
-bool is_player(Entity *entity) {
-  return dynamic_cast<Player *>(entity);
+bool is_player(const Entity *entity) {
+  return entity->kind == Entity::PLAYER;
 }
@@ -4,12 +4,17 @@
 #include <vector>
 #include <memory>
 #include <util/util.h>
+#include <collections/cow_pool.h>
 #include <dungeon/object.h>
 typedef size_t EIdx;
 
+// Entities have no virtual functions, kind says which class one really is.
 class Entity {
-    virtual void no_op();
     public:
+        enum Kind : uint8_t {
+            PLAYER,
+            MONSTER
+        } kind;
         int hp;
         bool alive;
         int row;
@@ -17,7 +22,7 @@ class Entity {
         int speed;
         char print;
         EIdx index;
-        Entity(int row, int col);
+        Entity(Kind kind, int row, int col);
 };
 
 enum class EquipmentSelector {
@@ -35,27 +40,48 @@ enum class EquipmentSelector {
     RingB
 };
 
+// totals over the player's equipment, worked out again only when it changes
+typedef struct {
+    int speed;
+    int defense;
+    DicePool damage;
+} PlayerStats;
+
 class Player: public Entity {
     public:
         Dice base_damage;
         OIdx carry[10];
         OIdx equipment[12];
+        PlayerStats stats;
         Player(int row, int col);
+        // recompute stats, must be called whenever equipment changes
+        void update_stats(ObjectStore *store);
 };
 
+// The state of a monster that its turns read and write. What it was spawned
+// with and never changes is kept apart in MonsterTraits, so a pass over the
+// monsters does not pull it through the cache. Position, speed, hp and alive
+// stay in this struct rather than in arrays of their own, since the game
+// hands out Entity pointers. The pool of these small structs is contiguous.
 class Monster: public Entity {
     public:
-        //std::string name;
-        int color;
-        Dice damage;
         bool smart :1;
         bool telepathic :1;
         bool tunneling :1;
         bool erratic :1;
         int pc_last_seen[2];
+        // while asleep, the turn the monster was next due to act
+        int wake_turn;
+        // neighbor index of the last step a smart monster took, -1 before the first
+        int last_step;
         Monster(int row, int col);
 };
 
+typedef struct {
+    int color;
+    Dice damage;
+} MonsterTraits;
+
 class MonsterDescription {
     public:
         std::string name;
@@ -74,20 +100,37 @@ class MonsterDescription {
         Dice damage;
         MonsterDescription();
         Monster generate(int row, int col);
+        MonsterTraits traits();
         void print();
 };
 
+// Players and monsters are kept in pools of their own class, so entities of
+// a kind sit next to each other in memory. Copies of a store share the pools'
+// chunks until an entity is handed out by get, which copies its chunk first
+// if it is shared. peek never copies, so it is the one to use for reading,
+// and the only one that is safe from several threads.
 class EntityStore {
-    std::vector<std::unique_ptr<Entity>> list;
+    // the pool an entity is in and its position there, by index - 1
+    typedef struct {
+        Entity::Kind kind;
+        uint32_t slot;
+    } Slot;
+
+    std::vector<Slot> slots;
+    // a floor has one player, so each is in a chunk of its own
+    CowPool<Player, 1> players;
+    CowPool<Monster> monsters;
+    // by the same position as monsters
+    CowPool<MonsterTraits> monster_traits;
     public:
-        template <typename E>
-        EIdx add_entity(E entity);
         EIdx spawn_player(int row, int col);
         EIdx spawn_monster(MonsterDescription& desc, int row, int col);
-        size_t size();
+        size_t size() const;
         Result<Entity *, Unit> get(EIdx index);
+        Result<const Entity *, Unit> peek(EIdx index) const;
+        const MonsterTraits& traits(const Monster *monster) const;
 };
 
-bool is_player(Entity *entity);
+bool is_player(const Entity *entity);
 
 #endif
\ No newline at end of file
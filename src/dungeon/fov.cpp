@@ -0,0 +1,118 @@
+#include <dungeon/fov.h>
+
+// Shadowcasting scans the map one octant at a time, moving outwards row by row.
+// Each opaque block casts a shadow between two slopes, and the scan recurses
+// into the lit gap that is left. The multipliers transform octant local
+// (dx, dy) offsets into map coordinates.
+static const int OCTANTS[8][4] = {{ 1,  0,  0,  1},
+                                  { 0,  1,  1,  0},
+                                  { 0, -1,  1,  0},
+                                  {-1,  0,  0,  1},
+                                  {-1,  0,  0, -1},
+                                  { 0, -1, -1,  0},
+                                  { 0,  1, -1,  0},
+                                  { 1,  0,  0, -1}};
+
+// The slopes bounding each block of an octant and its squared distance from
+// the origin only depend on the block's offset, so they are worked out at
+// compile time for every offset within FOV_MAX_RADIUS. Casting then needs no
+// division or multiplication per block. Indexed by [distance][dx + distance].
+typedef struct {
+    double l_slope;
+    double r_slope;
+    int distance_2;
+} OctantBlock;
+
+struct OctantTable {
+    OctantBlock blocks[FOV_MAX_RADIUS + 1][FOV_MAX_RADIUS + 1];
+    constexpr OctantTable(): blocks{} {
+        for(int i = 1; i <= FOV_MAX_RADIUS; i++) {
+            int dy = -i;
+            for(int dx = -i; dx <= 0; dx++) {
+                blocks[i][dx + i].l_slope = (dx - 0.5) / (dy + 0.5);
+                blocks[i][dx + i].r_slope = (dx + 0.5) / (dy - 0.5);
+                blocks[i][dx + i].distance_2 = dx * dx + dy * dy;
+            }
+        }
+    }
+};
+
+static constexpr OctantTable OCTANT_TABLE;
+
+typedef struct {
+    const Dungeon *dungeon;
+    VisibilityMap *visible;
+    int row;
+    int col;
+    int radius;
+} FovContext;
+
+static bool _blocks_sight(const Dungeon *dungeon, int row, int col);
+static void _cast_light(FovContext *context, int distance, double start, double end, const int transform[4]);
+
+void compute_fov(const Dungeon *dungeon, int row, int col, int radius, VisibilityMap *visible) {
+    visible->clear();
+    visible->set(row, col);
+
+    if (radius > FOV_MAX_RADIUS) {
+        radius = FOV_MAX_RADIUS;
+    }
+
+    FovContext context = {.dungeon = dungeon, .visible = visible, .row = row, .col = col, .radius = radius};
+    for(int i = 0; i < 8; i++) {
+        _cast_light(&context, 1, 1.0, 0.0, OCTANTS[i]);
+    }
+}
+
+static bool _blocks_sight(const Dungeon *dungeon, int row, int col) {
+    return dungeon->opaque.get(row, col);
+}
+
+static void _cast_light(FovContext *context, int distance, double start, double end, const int transform[4]) {
+    if (start < end) {
+        return;
+    }
+
+    int radius_2 = context->radius * context->radius;
+    double next_start = start;
+    for(int i = distance; i <= context->radius; i++) {
+        bool blocked = false;
+        int dy = -i;
+        for(int dx = -i; dx <= 0; dx++) {
+            const OctantBlock& block = OCTANT_TABLE.blocks[i][dx + i];
+            double l_slope = block.l_slope;
+            double r_slope = block.r_slope;
+            if (start < r_slope) {
+                continue;
+            } else if (end > l_slope) {
+                break;
+            }
+
+            int col = context->col + dx * transform[0] + dy * transform[1];
+            int row = context->row + dx * transform[2] + dy * transform[3];
+            bool in_bounds = row >= 0 && row < DUNGEON_HEIGHT && col >= 0 && col < DUNGEON_WIDTH;
+            if (in_bounds && block.distance_2 < radius_2) {
+                context->visible->set(row, col);
+            }
+
+            bool opaque = !in_bounds || _blocks_sight(context->dungeon, row, col);
+            if (blocked) {
+                if (opaque) {
+                    next_start = r_slope;
+                } else {
+                    blocked = false;
+                    start = next_start;
+                }
+            } else if (opaque && i < context->radius) {
+                // this block starts a shadow, scan the lit part before it one row further out
+                blocked = true;
+                _cast_light(context, i + 1, start, l_slope, transform);
+                next_start = r_slope;
+            }
+        }
+
+        if (blocked) {
+            break;
+        }
+    }
+}
@@ -0,0 +1,17 @@
+#ifndef FOV_H
+#define FOV_H
+
+#include <collections/bitgrid.h>
+#include <dungeon/dungeon.h>
+
+// the largest radius the precomputed shadowcasting tables cover
+#define FOV_MAX_RADIUS 24
+
+typedef BitGrid<DUNGEON_HEIGHT, DUNGEON_WIDTH> VisibilityMap;
+
+// mark every block visible from (row, col) within radius using recursive shadowcasting.
+// Blocks that stop sight (rock and pillars) are marked too, so walls show up.
+// The radius is capped at FOV_MAX_RADIUS.
+void compute_fov(const Dungeon *dungeon, int row, int col, int radius, VisibilityMap *visible);
+
+#endif
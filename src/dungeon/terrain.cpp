@@ -0,0 +1,142 @@
+#include <vector>
+#include <cstring>
+
+#include <dungeon/dungeon.h>
+#include <util/util.h>
+
+// Layers derived from the terrain that are kept up to date as blocks change.
+//
+// Components are 8-connected groups of walkable blocks. Two blocks with
+// different labels can never reach each other without tunneling, which lets
+// monsters skip path searches that are guaranteed to fail.
+//
+// The opacity layer holds one bit per block that stops line of sight, small
+// enough to stay in cache while the field of view is cast.
+//
+// The open neighbor mask has a bit for each of a block's 8 neighbors that is
+// not rock, which is what decides whether a rock block is drawn. Neighbors
+// wrap around the map edges the same way the renderer does.
+
+typedef struct {
+    int row;
+    int col;
+} Cell;
+
+static bool _walkable(Dungeon *dungeon, int row, int col);
+static void _label_components(Dungeon *dungeon);
+static void _fill_component(Dungeon *dungeon, int row, int col, uint16_t from, uint16_t to);
+
+// neighbor offsets in bit order, the neighbor in direction i sees us in direction 7 - i
+static const int NEIGHBORS[8][2] = {{-1, -1}, {-1, 0}, {-1, 1},
+                                    { 0, -1},          { 0, 1},
+                                    { 1, -1}, { 1, 0}, { 1, 1}};
+
+void index_terrain(Dungeon *dungeon) {
+    dungeon->open_neighbors.fill(0);
+    for(int row = 0; row < DUNGEON_HEIGHT; row++) {
+        for(int col = 0; col < DUNGEON_WIDTH; col++) {
+            dungeon->opaque.assign(row, col, !_walkable(dungeon, row, col));
+            if (dungeon->type[row][col] != DungeonBlock::ROCK) {
+                set_open_neighbor(dungeon->open_neighbors, row, col, true);
+            }
+        }
+    }
+
+    _label_components(dungeon);
+}
+
+static void _label_components(Dungeon *dungeon) {
+    dungeon->components = 0;
+    dungeon->component.fill(0);
+
+    for(int row = 0; row < DUNGEON_HEIGHT; row++) {
+        for(int col = 0; col < DUNGEON_WIDTH; col++) {
+            if (_walkable(dungeon, row, col) && dungeon->component[row][col] == 0) {
+                dungeon->components++;
+                _fill_component(dungeon, row, col, 0, dungeon->components);
+            }
+        }
+    }
+}
+
+void carve_block(Dungeon *dungeon, int row, int col) {
+    if (_walkable(dungeon, row, col)) {
+        return;
+    }
+    if (dungeon->type[row][col] == DungeonBlock::ROCK) {
+        set_open_neighbor(dungeon->open_neighbors, row, col, true);
+    }
+    dungeon->type.mut(row, col) = DungeonBlock::HALL;
+    dungeon->opaque.reset(row, col);
+
+    relative_array(1, row, col, DUNGEON_HEIGHT, DUNGEON_WIDTH, );
+    int adjacent[8][2] = {{top, left}   , {top, col}   , {top, right},
+                          {row, left}   ,                {row, right},
+                          {bottom, left}, {bottom, col}, {bottom, right}};
+
+    // join the new hall to the first component it touches, then pull any
+    // other touching components into that one
+    uint16_t label = 0;
+    for(int i = 0; i < 8; i++) {
+        uint16_t other = dungeon->component[adjacent[i][0]][adjacent[i][1]];
+        if (other == 0 || other == label) {
+            continue;
+        }
+
+        if (label == 0) {
+            label = other;
+        } else {
+            _fill_component(dungeon, adjacent[i][0], adjacent[i][1], other, label);
+        }
+    }
+
+    if (label == 0) {
+        dungeon->components++;
+        label = dungeon->components;
+    }
+    dungeon->component.mut(row, col) = label;
+}
+
+void set_open_neighbor(OpenNeighbors& open_neighbors, int row, int col, bool open) {
+    for(int i = 0; i < 8; i++) {
+        int n_row = (row + NEIGHBORS[i][0] + DUNGEON_HEIGHT) % DUNGEON_HEIGHT;
+        int n_col = (col + NEIGHBORS[i][1] + DUNGEON_WIDTH) % DUNGEON_WIDTH;
+        uint8_t bit = 1 << (7 - i);
+        if (open) {
+            open_neighbors.mut(n_row, n_col) |= bit;
+        } else {
+            open_neighbors.mut(n_row, n_col) &= ~bit;
+        }
+    }
+}
+
+static bool _walkable(Dungeon *dungeon, int row, int col) {
+    return dungeon->type[row][col] != DungeonBlock::ROCK &&
+        dungeon->type[row][col] != DungeonBlock::PILLAR;
+}
+
+static void _fill_component(Dungeon *dungeon, int row, int col, uint16_t from, uint16_t to) {
+    // components can span most of the map, so use an explicit stack rather than recursion
+    std::vector<Cell> stack;
+    dungeon->component.mut(row, col) = to;
+    stack.push_back((Cell){.row = row, .col = col});
+
+    while(stack.size() > 0) {
+        Cell cell = stack.back();
+        stack.pop_back();
+
+        relative_array(1, cell.row, cell.col, DUNGEON_HEIGHT, DUNGEON_WIDTH, );
+        int adjacent[8][2] = {{top, left}       , {top, cell.col}   , {top, right},
+                              {cell.row, left}  ,                     {cell.row, right},
+                              {bottom, left}    , {bottom, cell.col}, {bottom, right}};
+
+        for(int i = 0; i < 8; i++) {
+            int a_row = adjacent[i][0];
+            int a_col = adjacent[i][1];
+            if (dungeon->component[a_row][a_col] == from && _walkable(dungeon, a_row, a_col)) {
+                dungeon->component.mut(a_row, a_col) = to;
+                stack.push_back((Cell){.row = a_row, .col = a_col});
+            }
+        }
+    }
+}
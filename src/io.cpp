@@ -29,11 +29,11 @@
 #define DISTANCE_8 "\033[1;7;31;40m%c\033[0m"
 #define DISTANCE_9 "\033[37;45m%c\033[0m"
 
-static void print_block(DungeonBlock block, bool visible, int row, int col);
-static void print_entity(Entity *entity, int row, int col);
+static void print_block(DungeonBlock::Type type, uint8_t hardness, bool visible, int row, int col);
+static void print_entity(const EntityStore *store, EIdx index, int row, int col);
 static void print_object(Object *entity, int row, int col);
-static void print_hardness(char c, DungeonBlock block, int row, int col);
-static void print_s_hardness(char c, DungeonBlock block, int row, int col);
+static void print_hardness(char c, uint8_t hardness, int row, int col);
+static void print_s_hardness(char c, uint8_t hardness, int row, int col);
 static void print_distance(int distance);
 static int _string_to_color(std::string& color_str);
 typedef union {
@@ -47,6 +47,8 @@ static int SCREEN_COLS = 80;
 static int GAME_SCREEN_ROWS = 21;
 static int GAME_SCREEN_COLS = 80;
 
+// Both stay NULL when init_screen is never called, as in soak runs. Nothing is
+// drawn then and no input is read.
 static WINDOW *main_screen = NULL;
 static WINDOW *game_screen = NULL;
 
@@ -102,10 +104,17 @@ void init_screen(bool full_size) {
 }
 
 int get_input(void) {
+    if (main_screen == NULL) {
+        return ERR;
+    }
     return wgetch(game_screen);
 }
 
 void print_view(GameState *state, int center_row, int center_col) {
+    if (main_screen == NULL) {
+        return;
+    }
+    const View& view = state->view;
     wbkgd(main_screen, COLOR_PAIR(6));
     int start_row = center_row - (GAME_SCREEN_ROWS / 2);
     int end_row = start_row + GAME_SCREEN_ROWS;
@@ -119,27 +128,18 @@ void print_view(GameState *state, int center_row, int center_col) {
                 continue;
             }
 
-            int right = (col >= DUNGEON_WIDTH - 1) ? 0 : col + 1;
-            int left = (col <= 0) ? DUNGEON_WIDTH - 1 : col - 1;
-            int top = (row <= 0) ? DUNGEON_HEIGHT - 1 : row - 1;
-            int bottom = (row >= DUNGEON_HEIGHT - 1) ? 0 : row + 1;
-            bool visible = false;
-
-            visible |= state->view.blocks[top][left].type != DungeonBlock::ROCK;
-            visible |= state->view.blocks[top][col].type != DungeonBlock::ROCK;
-            visible |= state->view.blocks[top][right].type != DungeonBlock::ROCK;
-            visible |= state->view.blocks[row][left].type != DungeonBlock::ROCK;
-            visible |= state->view.blocks[row][right].type != DungeonBlock::ROCK;
-            visible |= state->view.blocks[bottom][left].type != DungeonBlock::ROCK;
-            visible |= state->view.blocks[bottom][col].type != DungeonBlock::ROCK;
-            visible |= state->view.blocks[bottom][right].type != DungeonBlock::ROCK;
-
-            if (state->view.blocks[row][col].entity_id != 0) {
-                print_entity(state->dungeon.store->get(state->view.blocks[row][col].entity_id).unwrap(), row - start_row, col - start_col);
-            } else if (state->view.blocks[row][col].object_id != 0) {
-                print_object(state->dungeon.o_store->get(state->view.blocks[row][col].object_id).unwrap(), row - start_row, col - start_col);;
+            bool visible = view.open_neighbors[row][col] != 0;
+
+            // entities are only shown while in view, objects stay where they were last seen
+            EIdx entity_id = view.visible.get(row, col) ? state->dungeon.entities[row][col] : 0;
+            OIdx object_id = view.type[row][col] != DungeonBlock::ROCK ? state->dungeon.objects[row][col] : 0;
+            if (entity_id != 0) {
+                print_entity(state->dungeon.store.get(), entity_id, row - start_row, col - start_col);
+            } else if (object_id != 0) {
+                print_object(state->dungeon.o_store->get(object_id).unwrap(), row - start_row, col - start_col);
             } else {
-                print_block(state->view.blocks[row][col], visible, row - start_row, col - start_col);
+                DungeonBlock::Type type = static_cast<DungeonBlock::Type>(view.type[row][col]);
+                print_block(type, view.hardness[row][col], visible, row - start_row, col - start_col);
             }
         }
     }
@@ -148,6 +148,9 @@ void print_view(GameState *state, int center_row, int center_col) {
 }
 
 void print_dungeon(const Dungeon *dungeon, int center_row, int center_col) {
+    if (main_screen == NULL) {
+        return;
+    }
     wbkgd(main_screen, COLOR_PAIR(6));
     int start_row = center_row - (GAME_SCREEN_ROWS / 2);
     int end_row = start_row + GAME_SCREEN_ROWS;
@@ -161,27 +164,17 @@ void print_dungeon(const Dungeon *dungeon, int center_row, int center_col) {
                 continue;
             }
 
-            int right = (col >= DUNGEON_WIDTH - 1) ? 0 : col + 1;
-            int left = (col <= 0) ? DUNGEON_WIDTH - 1 : col - 1;
-            int top = (row <= 0) ? DUNGEON_HEIGHT - 1 : row - 1;
-            int bottom = (row >= DUNGEON_HEIGHT - 1) ? 0 : row + 1;
-            bool visible = false;
-
-            visible |= dungeon->blocks[top][left].type != DungeonBlock::ROCK;
-            visible |= dungeon->blocks[top][col].type != DungeonBlock::ROCK;
-            visible |= dungeon->blocks[top][right].type != DungeonBlock::ROCK;
-            visible |= dungeon->blocks[row][left].type != DungeonBlock::ROCK;
-            visible |= dungeon->blocks[row][right].type != DungeonBlock::ROCK;
-            visible |= dungeon->blocks[bottom][left].type != DungeonBlock::ROCK;
-            visible |= dungeon->blocks[bottom][col].type != DungeonBlock::ROCK;
-            visible |= dungeon->blocks[bottom][right].type != DungeonBlock::ROCK;
-
-            if (dungeon->blocks[row][col].entity_id != 0) {
-                print_entity(dungeon->store->get(dungeon->blocks[row][col].entity_id).unwrap(), row - start_row, col - start_col);
-            } else if (dungeon->blocks[row][col].object_id != 0) {
-                print_object(dungeon->o_store->get(dungeon->blocks[row][col].object_id).unwrap(), row - start_row, col - start_col);;
+            bool visible = dungeon->open_neighbors[row][col] != 0;
+
+            EIdx entity_id = dungeon->entities[row][col];
+            OIdx object_id = dungeon->objects[row][col];
+            if (entity_id != 0) {
+                print_entity(dungeon->store.get(), entity_id, row - start_row, col - start_col);
+            } else if (object_id != 0) {
+                print_object(dungeon->o_store->get(object_id).unwrap(), row - start_row, col - start_col);;
             } else {
-                print_block(dungeon->blocks[row][col], visible, row - start_row, col - start_col);
+                DungeonBlock::Type type = static_cast<DungeonBlock::Type>(dungeon->type[row][col]);
+                print_block(type, dungeon->hardness[row][col], visible, row - start_row, col - start_col);
             }
         }
     }
@@ -190,10 +183,13 @@ void print_dungeon(const Dungeon *dungeon, int center_row, int center_col) {
 }
 
 void print_pc_inventory(Dungeon *dungeon) {
+    if (main_screen == NULL) {
+        return;
+    }
     wbkgd(main_screen, COLOR_PAIR(2));
     wclear(main_screen);
     for(int i = 0; i < 10; i++) {
-        OIdx o_index = static_cast<Player *>(dungeon->store->get(dungeon->player_id).unwrap())->carry[i];
+        OIdx o_index = static_cast<const Player *>(dungeon->store->peek(dungeon->player_id).unwrap())->carry[i];
         if (o_index == 0) {
             mvwprintw(main_screen, i*2, 0, "%d) Empty", i);
         } else {
@@ -205,10 +201,13 @@ void print_pc_inventory(Dungeon *dungeon) {
 }
 
 void print_pc_equipment(Dungeon *dungeon) {
+    if (main_screen == NULL) {
+        return;
+    }
     wbkgd(main_screen, COLOR_PAIR(2));
     wclear(main_screen);
     for(int i = 0; i < 12; i++) {
-        OIdx o_index = static_cast<Player *>(dungeon->store->get(dungeon->player_id).unwrap())->equipment[i];
+        OIdx o_index = static_cast<const Player *>(dungeon->store->peek(dungeon->player_id).unwrap())->equipment[i];
         if (o_index == 0) {
             mvwprintw(main_screen, i*2, 0, "%c) Empty", 'a' + i);
         } else {
@@ -220,6 +219,9 @@ void print_pc_equipment(Dungeon *dungeon) {
 }
 
 void print_item_description(Dungeon *dungeon, OIdx index) {
+    if (main_screen == NULL) {
+        return;
+    }
     wbkgd(main_screen, COLOR_PAIR(2));
     wclear(main_screen);
     if (index == 0) {
@@ -233,6 +235,9 @@ void print_item_description(Dungeon *dungeon, OIdx index) {
 }
 
 int prompt_player(const char* prompt) {
+    if (main_screen == NULL) {
+        return ERR;
+    }
     wattron(main_screen, COLOR_PAIR(7));
     mvwprintw(main_screen, SCREEN_ROWS - 2, 0, "%s: ", prompt);
     wrefresh(main_screen);
@@ -242,6 +247,9 @@ int prompt_player(const char* prompt) {
 }
 
 void notify(const char* prompt, int row_off) {
+    if (main_screen == NULL) {
+        return;
+    }
     wattron(main_screen, COLOR_PAIR(7));
     mvwprintw(main_screen, SCREEN_ROWS - row_off, 0, "%s: ", prompt);
     wrefresh(main_screen);
@@ -521,13 +529,12 @@ void save_dungeon(Dungeon *dungeon, char* path) {
 
     for(int row = 0; row < DUNGEON_HEIGHT; row++) {
         for(int col = 0; col < DUNGEON_WIDTH; col++) {
-            DungeonBlock block = dungeon->blocks[row][col];
-            if(block.type != DungeonBlock::ROCK) {
+            if(dungeon->type[row][col] != DungeonBlock::ROCK) {
                 fputc(0, file);
-            } else if (block.immutable) {
+            } else if (dungeon->immutable.get(row, col)) {
                 fputc(255, file);
             } else {
-                fputc(block.hardness, file);
+                fputc(dungeon->hardness[row][col], file);
             }
         }
     }
@@ -535,8 +542,8 @@ void save_dungeon(Dungeon *dungeon, char* path) {
     uint32_t room_store_size = 0;
     for(int row = 0; row < DUNGEON_HEIGHT; row++) {
         for(int col = 0; col < DUNGEON_WIDTH; col++) {
-            DungeonBlock block = dungeon->blocks[row][col];
-            if(block.type != DungeonBlock::ROCK && block.type != DungeonBlock::HALL) {
+            uint8_t type = dungeon->type[row][col];
+            if(type != DungeonBlock::ROCK && type != DungeonBlock::HALL) {
                 fputc(col, file);
                 fputc(row, file);
                 fputc(1, file);
@@ -556,8 +563,8 @@ void save_dungeon(Dungeon *dungeon, char* path) {
     for(int row = 0; row < DUNGEON_HEIGHT; row++) {
         for(int col = 0; col < DUNGEON_WIDTH; col++) {
             // load row major type and real hardness
-            fputc(dungeon->blocks[row][col].hardness, file);
-            fputc(dungeon->blocks[row][col].type, file);
+            fputc(dungeon->hardness[row][col], file);
+            fputc(dungeon->type[row][col], file);
         }
     }
 
@@ -588,17 +595,18 @@ Dungeon load_dungeon(char* path) {
     for(int row = 0; row < DUNGEON_HEIGHT; row++) {
         for(int col = 0; col < DUNGEON_WIDTH; col++) {
             uint8_t hardness = fgetc(file);
-            dungeon.blocks[row][col].hardness = hardness;
-            dungeon.blocks[row][col].region = 0;
+            dungeon.hardness.mut(row, col) = hardness;
+            dungeon.region.mut(row, col) = 0;
+            dungeon.room.mut(row, col) = 0;
 
             if (hardness == 0) {
-                dungeon.blocks[row][col].type = DungeonBlock::HALL;
-                dungeon.blocks[row][col].immutable = false;
+                dungeon.type.mut(row, col) = DungeonBlock::HALL;
+                dungeon.immutable.assign(row, col, false);
             } else if (hardness == 255) {
-                dungeon.blocks[row][col].type = DungeonBlock::ROCK;
-                dungeon.blocks[row][col].immutable = true;
+                dungeon.type.mut(row, col) = DungeonBlock::ROCK;
+                dungeon.immutable.assign(row, col, true);
             } else {
-                dungeon.blocks[row][col].type = DungeonBlock::ROCK;
+                dungeon.type.mut(row, col) = DungeonBlock::ROCK;
             }
         }
     }
@@ -611,7 +619,7 @@ Dungeon load_dungeon(char* path) {
 
         for(int h = 0; h < height; h++) {
             for(int w = 0; w < width; w++) {
-                dungeon.blocks[row + h][col + w].type = DungeonBlock::FLOOR;
+                dungeon.type.mut(row + h, col + w) = DungeonBlock::FLOOR;
             }
         }
     }
@@ -620,6 +628,7 @@ Dungeon load_dungeon(char* path) {
     // if we have reached end of file return, otherwise we have special information to load
     if(feof(file)) {
         fclose(file);
+        index_terrain(&dungeon);
         return dungeon;
     }
 
@@ -632,28 +641,30 @@ Dungeon load_dungeon(char* path) {
 
     if (magic.num != 0x0BADF00D) {
         fclose(file);
+        index_terrain(&dungeon);
         return dungeon;
     }
 
     for(int row = 0; row < DUNGEON_HEIGHT; row++) {
         for(int col = 0; col < DUNGEON_WIDTH; col++) {
             // load row major type and real hardness
-            dungeon.blocks[row][col].hardness = fgetc(file);
-            dungeon.blocks[row][col].type = static_cast<DungeonBlock::Type>(fgetc(file));
+            dungeon.hardness.mut(row, col) = fgetc(file);
+            dungeon.type.mut(row, col) = fgetc(file);
         }
     }
     
     fclose(file);
+    index_terrain(&dungeon);
     return dungeon;
 }
 
-static void print_block(DungeonBlock block, bool visible, int row, int col) {
+static void print_block(DungeonBlock::Type type, uint8_t hardness, bool visible, int row, int col) {
     char c;
-    switch(block.type) {
+    switch(type) {
         default:
         case DungeonBlock::ROCK:
             if (visible) {
-                print_s_hardness(' ', block, row, col);
+                print_s_hardness(' ', hardness, row, col);
             } else {
                 mvwprintw(game_screen, row, col, " ");
             }
@@ -678,15 +689,16 @@ static void print_block(DungeonBlock block, bool visible, int row, int col) {
             break;
     }
 
-    print_hardness(c, block, row, col);
+    print_hardness(c, hardness, row, col);
 }
 
-static void print_entity(Entity *entity, int row, int col) {
+static void print_entity(const EntityStore *store, EIdx index, int row, int col) {
+    const Entity *entity = store->peek(index).unwrap();
     init_pair(5, COLOR_GREEN, COLOR_BLACK);
     if (is_player(entity)) {
         wattron(game_screen, COLOR_PAIR(5));
     } else {
-        int color = ((Monster *)entity)->color;
+        int color = store->traits(static_cast<const Monster *>(entity)).color;
         wattron(game_screen, COLOR_PAIR(color));
     }
     mvwprintw(game_screen, row, col, "%c", entity->print);
@@ -698,29 +710,25 @@ static void print_object(Object *object, int row, int col) {
     mvwprintw(game_screen, row, col, "%c", object->print);
 }
 
-static void print_s_hardness(char c, DungeonBlock block, int row, int col) {
+static void print_s_hardness(char c, uint8_t hardness, int row, int col) {
     wattron(game_screen, A_REVERSE);
-    if (block.immutable) {
-        wattron(game_screen, COLOR_PAIR(4));
-        mvwprintw(game_screen, row, col, "%c", c);
-        wattroff(game_screen, COLOR_PAIR(4));
-    } else if (block.hardness < HARDNESS_TIER_1) {
+    if (hardness < HARDNESS_TIER_1) {
         wattron(game_screen, A_BOLD);
         wattron(game_screen, COLOR_PAIR(1));
         mvwprintw(game_screen, row, col, "%c", c);
         wattroff(game_screen, COLOR_PAIR(1));
         wattroff(game_screen, A_BOLD);
-    } else if (block.hardness < HARDNESS_TIER_2) {
+    } else if (hardness < HARDNESS_TIER_2) {
         wattron(game_screen, A_BOLD);
         wattron(game_screen, COLOR_PAIR(2));
         mvwprintw(game_screen, row, col, "%c", c);
         wattroff(game_screen, COLOR_PAIR(2));
         wattroff(game_screen, A_BOLD);
-    } else if (block.hardness < HARDNESS_TIER_3) {
+    } else if (hardness < HARDNESS_TIER_3) {
         wattron(game_screen, COLOR_PAIR(2));
         mvwprintw(game_screen, row, col, "%c", c);
         wattroff(game_screen, COLOR_PAIR(2));
-    } else if (block.hardness < HARDNESS_TIER_MAX) {
+    } else if (hardness < HARDNESS_TIER_MAX) {
         wattron(game_screen, A_BOLD);
         wattron(game_screen, COLOR_PAIR(3));
         mvwprintw(game_screen, row, col, "%c", c);
@@ -734,28 +742,24 @@ static void print_s_hardness(char c, DungeonBlock block, int row, int col) {
     wattroff(game_screen, A_REVERSE);
 }
 
-static void print_hardness(char c, DungeonBlock block, int row, int col) {
-    if (block.immutable) {
-        wattron(game_screen, COLOR_PAIR(4));
-        mvwprintw(game_screen, row, col, "%c", c);
-        wattroff(game_screen, COLOR_PAIR(4));
-    } else if (block.hardness < HARDNESS_TIER_1) {
+static void print_hardness(char c, uint8_t hardness, int row, int col) {
+    if (hardness < HARDNESS_TIER_1) {
         wattron(game_screen, A_BOLD);
         wattron(game_screen, COLOR_PAIR(1));
         mvwprintw(game_screen, row, col, "%c", c);
         wattroff(game_screen, COLOR_PAIR(1));
         wattroff(game_screen, A_BOLD);
-    } else if (block.hardness < HARDNESS_TIER_2) {
+    } else if (hardness < HARDNESS_TIER_2) {
         wattron(game_screen, A_BOLD);
         wattron(game_screen, COLOR_PAIR(2));
         mvwprintw(game_screen, row, col, "%c", c);
         wattroff(game_screen, COLOR_PAIR(2));
         wattroff(game_screen, A_BOLD);
-    } else if (block.hardness < HARDNESS_TIER_3) {
+    } else if (hardness < HARDNESS_TIER_3) {
         wattron(game_screen, COLOR_PAIR(2));
         mvwprintw(game_screen, row, col, "%c", c);
         wattroff(game_screen, COLOR_PAIR(2));
-    } else if (block.hardness < HARDNESS_TIER_MAX) {
+    } else if (hardness < HARDNESS_TIER_MAX) {
         wattron(game_screen, A_BOLD);
         wattron(game_screen, COLOR_PAIR(3));
         mvwprintw(game_screen, row, col, "%c", c);
@@ -1,91 +1,325 @@
 #include <climits>
+#include <cstring>
+#include <thread>
+#include <algorithm>
 #include <unistd.h>
 #include <loop.h>
 #include <dungeon/entities.h>
 #include <dungeon/dungeon.h>
 #include <util/distance.h>
 #include <io.h>
-#include <collections/heap.h>
+#include <collections/timing_wheel.h>
 
 #include <ncurses.h>
 
-static void _init_floor_state(Dungeon &dungeon, Heap<Event> &heap, View &view);
 static int _length_no_tunnel(const Dungeon& context, Coordinate *from, Coordinate *to);
 static int _length_tunnel(const Dungeon& context, Coordinate *from, Coordinate *to);
+static int _length_remembered(const View& context, Coordinate *from, Coordinate *to);
 
-static void _init_floor_state(Dungeon &dungeon, Heap<Event> &heap, View &view) {
-    for(EIdx i = 1; i <= dungeon.store->size(); i++) {
-        heap.push((Event){.turn = 0, .entity_id = i, .event_type = Event::MOVE});
-    }
+GameState::GameState(Dungeon dungeon) : dungeon(std::move(dungeon)) {
+    terrain_version = 0;
+    ai_threads = 1;
+    ai_budget = 0;
+    ai_spent = std::chrono::steady_clock::duration::zero();
+    bot = false;
+    floors = 1;
+    depth = 0;
+    init_floor();
+    pregenerate_floor();
+    
+    update_player_view();
+}
 
-    // TODO build the first view
-    for(int row = 0; row < DUNGEON_HEIGHT; row++) {
-        for(int col = 0; col < DUNGEON_WIDTH; col++) {
-            view.blocks[row][col] = (DungeonBlock){.type = DungeonBlock::ROCK, .hardness = 200, .region = 0, .immutable = false, .entity_id = 0, .object_id = 0};
+// every monster starts the floor asleep, only the ones near the player are woken up
+void GameState::init_floor() {
+    event_queue.mut().clear();
+    sleeping.mut().clear();
+    route.mut().clear();
+    exploring = false;
+    current_turn = 0;
+    for(EIdx i = 1; i <= dungeon.store->size(); i++) {
+        if (i == dungeon.player_id) {
+            event_queue.mut().push((Event){.turn = 0, .entity_id = i, .event_type = Event::MOVE});
+        } else {
+            // turns count from 0 again, even on a floor that was visited before
+            static_cast<Monster *>(dungeon.store->get(i).unwrap())->wake_turn = 0;
+            sleeping.mut().push_back(i);
         }
     }
+    wake_monsters();
+
+    view.type.fill(DungeonBlock::ROCK);
+    view.hardness.fill(200);
+    view.open_neighbors.fill(0);
+    view.visible.clear();
+    view.explored.clear();
+    view_dirty.clear();
+    fov_dirty = true;
 }
 
-GameState::GameState(Dungeon dungeon): event_queue([] (auto from, auto to) {return from.turn - to.turn;}) {
-    this->dungeon = dungeon;
-    _init_floor_state(dungeon, this->event_queue, this->view);
-    
-    update_player_view();
+GameState GameState::snapshot() const {
+    GameState copy = *this;
+    // the entity list is copied so each side can swap in its own copies of the entities it writes
+    copy.dungeon = dungeon.clone();
+    return copy;
+}
+
+void GameState::restore(const GameState& snapshot) {
+    *this = snapshot;
+    dungeon = snapshot.dungeon.clone();
 }
 
 void destroy_state(GameState *state) {
     destroy_dungeon(&state->dungeon);
 }
 
-void GameState::new_floor() {
-    event_queue.clear();
-    rebuild_dungeon(&dungeon);
-    _init_floor_state(dungeon, event_queue, view);
+// Take the stairs up (-1) or down (1). The floor being left is kept, and a
+// floor that was visited before is returned to as it was left, otherwise the
+// pregenerated floor is used. The player is carried over either way.
+void GameState::new_floor(int direction) {
+    Player traveller = *static_cast<const Player *>(dungeon.store->peek(dungeon.player_id).unwrap());
+    visited[depth] = std::make_shared<const VisitedFloor>((VisitedFloor){std::move(dungeon), view});
+    depth += direction;
+
+    // once full, drop the floor farthest from the new one
+    if (visited.size() > FLOOR_CACHE_SIZE) {
+        auto nearest_end = std::prev(visited.end());
+        if (abs(visited.begin()->first - depth) >= abs(nearest_end->first - depth)) {
+            visited.erase(visited.begin());
+        } else {
+            visited.erase(nearest_end);
+        }
+    }
+
+    auto floor = visited.find(depth);
+    bool returning = floor != visited.end();
+    View remembered;
+    // snapshots may share this floor, so its entities are copied as they are written
+    if (returning) {
+        dungeon = floor->second->dungeon.clone();
+        remembered = floor->second->view;
+        visited.erase(floor);
+    } else {
+        dungeon = next_floor.get().clone();
+        floors++;
+        pregenerate_floor();
+    }
+
+    // the player takes the place of the floor's own player entity
+    Player *arrival = static_cast<Player *>(dungeon.store->get(dungeon.player_id).unwrap());
+    traveller.row = arrival->row;
+    traveller.col = arrival->col;
+    traveller.index = arrival->index;
+    *arrival = traveller;
+    arrival->update_stats(dungeon.o_store.get());
+
+    init_floor();
+    if (returning) {
+        view = remembered;
+    }
+}
+
+// Start generating the next floor on its own thread. The streams there are
+// seeded from this thread's dungeon stream, so a seeded game still plays out the same.
+void GameState::pregenerate_floor() {
+    Options *params = dungeon.params;
+    std::shared_ptr<ObjectStore> o_store = dungeon.o_store;
+    uint32_t seed = better_rand(INT_MAX - 1);
+    next_floor = std::async(std::launch::async, [params, o_store, seed]() {
+        seed_rand(seed);
+        return create_dungeon(params, o_store);
+    }).share();
+}
+
+int GameState::action_delay(const Entity *entity) {
+    int speed = entity->speed;
+    if (is_player(entity)) {
+        speed = static_cast<const Player *>(entity)->stats.speed;
+    }
+    if (speed < 1) {
+        speed = 1;
+    }
+    return 1000/speed;
+}
+
+bool GameState::perceives_player(const Monster *entity, int radius) {
+    const Entity *player = dungeon.store->peek(dungeon.player_id).unwrap();
+    if (entity->telepathic) {
+        return true;
+    }
+
+    int room = dungeon.room[entity->row][entity->col];
+    if (room != 0 && room == dungeon.room[player->row][player->col]) {
+        return true;
+    }
+
+    return abs(entity->row - player->row) <= radius && abs(entity->col - player->col) <= radius;
+}
+
+// put monsters that notice the player back in the queue, on the first turn
+// they would have acted had they been awake all along
+void GameState::wake_monsters() {
+    size_t i = 0;
+    while (i < sleeping->size()) {
+        const Monster *monster = static_cast<const Monster *>(dungeon.store->peek((*sleeping)[i]).unwrap());
+        if (monster->alive && !perceives_player(monster, MONSTER_WAKE_RADIUS)) {
+            i++;
+            continue;
+        }
+
+        if (monster->alive) {
+            int delay = action_delay(monster);
+            int turn = monster->wake_turn;
+            if (turn < current_turn) {
+                turn += (current_turn - turn + delay - 1) / delay * delay;
+            }
+            event_queue.mut().push((Event){.turn = turn, .entity_id = monster->index, .event_type = Event::MOVE});
+        }
+        sleeping.mut()[i] = sleeping->back();
+        sleeping.mut().pop_back();
+    }
 }
 
 bool GameState::tick() {
-    Event event = event_queue.pop();
-    Entity *entity = dungeon.store->get(event.entity_id).unwrap();
+    // the player's own turn is never batched, even while it runs without input on a route
+    if (ai_threads > 1 && !event_queue->is_empty() && event_queue->peek().entity_id != dungeon.player_id) {
+        tick_batch();
+    } else {
+        run_event(event_queue.mut().pop(), NULL);
+    }
+    return false;
+}
 
-    if (!entity->alive) {
-        return false;
+// Pop every monster event due on the next turn, up to the player's, and plan
+// their moves in parallel against the dungeon as it is now. The events are
+// then run one at a time in queue order, exactly as tick would run them, so
+// a plan is only taken when nothing it depends on has changed in between.
+void GameState::tick_batch() {
+    if (event_queue->is_empty()) {
+        return;
+    }
+
+    std::vector<Event> batch;
+    int turn = event_queue->peek().turn;
+    while (!event_queue->is_empty() && event_queue->peek().turn == turn &&
+        event_queue->peek().entity_id != dungeon.player_id) {
+        batch.push_back(event_queue.mut().pop());
+    }
+
+    std::vector<MovePlan> plans(batch.size());
+    plan_moves(batch, plans);
+    for(size_t i = 0; i < batch.size(); i++) {
+        run_event(batch[i], &plans[i]);
+        // the game ends with the player, as it does when events are run one per tick
+        if (!dungeon.store->peek(dungeon.player_id).unwrap()->alive) {
+            for(size_t j = i + 1; j < batch.size(); j++) {
+                event_queue.mut().push(batch[j]);
+            }
+            return;
+        }
     }
+}
+
+void GameState::plan_moves(const std::vector<Event>& batch, std::vector<MovePlan>& plans) {
+    std::vector<size_t> work;
+    for(size_t i = 0; i < batch.size(); i++) {
+        plans[i].valid = false;
+        const Entity *entity = dungeon.store->peek(batch[i].entity_id).unwrap();
+        if (entity->alive && !is_player(entity) && static_cast<const Monster *>(entity)->smart) {
+            work.push_back(i);
+        }
+    }
+
+    // a single search is not worth starting a thread for
+    if (work.size() < 2) {
+        return;
+    }
+
+    // nothing is written to the game state until every worker is done
+    auto worker = [&](size_t first, size_t stride) {
+        for(size_t w = first; w < work.size(); w += stride) {
+            size_t i = work[w];
+            const Monster *monster = static_cast<const Monster *>(dungeon.store->peek(batch[i].entity_id).unwrap());
+            Coord target = peek_target(monster);
+            if (!monster->tunneling &&
+                dungeon.component[monster->row][monster->col] != dungeon.component[target.row][target.col]) {
+                continue;
+            }
+
+            plans[i].row = monster->row;
+            plans[i].col = monster->col;
+            plans[i].target = target;
+            plans[i].terrain_version = terrain_version;
+            plans[i].step = choose_step(monster, target);
+            plans[i].valid = true;
+        }
+    };
+
+    size_t threads = std::min((size_t)ai_threads, work.size());
+    std::vector<std::thread> workers;
+    for(size_t t = 1; t < threads; t++) {
+        workers.push_back(std::thread(worker, t, threads));
+    }
+    worker(0, threads);
+    for(std::thread& t : workers) {
+        t.join();
+    }
+}
+
+void GameState::run_event(Event event, const MovePlan *plan) {
+    // events of dead entities are dropped without copying anything shared with a snapshot
+    if (!dungeon.store->peek(event.entity_id).unwrap()->alive) {
+        return;
+    }
+    Entity *entity = dungeon.store->get(event.entity_id).unwrap();
+    current_turn = event.turn;
     
     bool rebuilt = false;
     if (!is_player(entity)) {
-        rebuilt = monster_move(static_cast<Monster *>(entity));
+        Monster *monster = static_cast<Monster *>(entity);
+        if (!perceives_player(monster, MONSTER_SLEEP_RADIUS)) {
+            monster->wake_turn = event.turn;
+            sleeping.mut().push_back(monster->index);
+            return;
+        }
+        rebuilt = monster_move(monster, plan);
     } else {
         rebuilt = player_move(static_cast<Player *>(entity));
+        fov_dirty = true;
+        ai_spent = std::chrono::steady_clock::duration::zero();
+        if (!rebuilt) {
+            wake_monsters();
+        }
     }
 
     if (!rebuilt) {
-        int speed = entity->speed;
-        if (is_player(entity)) {
-            Player *player = static_cast<Player *>(entity);
-            for(int i = 0; i < 12; i++) {
-                OIdx o_index = player->equipment[i];
-                if (o_index != 0) {
-                    speed += dungeon.o_store->get(o_index).unwrap()->speed_bonus;
-                }
-            }
-        }
-        if (speed < 1) {
-            speed = 1;
-        }
-        event.turn = event.turn + 1000/speed;
-        event_queue.push(event);
-    } else {
-        for(int row = 0; row < DUNGEON_HEIGHT; row++) {
-            for(int col = 0; col < DUNGEON_WIDTH; col++) {
-                view.blocks[row][col] = (DungeonBlock){.type = DungeonBlock::ROCK, .hardness = 200, .region = 0, .immutable = false, .entity_id = 0, .object_id = 0};
-            }
-        }
+        event.turn = event.turn + action_delay(entity);
+        event_queue.mut().push(event);
     }
     update_player_view();
+}
+
+bool GameState::awaiting_input() {
+    return !event_queue->is_empty() && event_queue->peek().entity_id == dungeon.player_id &&
+        route->empty() && !exploring;
+}
+
+RenderScheduler::RenderScheduler(bool animate, int frames_per_second) {
+    this->animate = animate;
+    frame_time = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::seconds(1)) / frames_per_second;
+    last_frame = std::chrono::steady_clock::now();
+}
+
+bool RenderScheduler::should_render(GameState *state) {
+    auto now = std::chrono::steady_clock::now();
+    if (state->awaiting_input() || (animate && now - last_frame >= frame_time)) {
+        last_frame = now;
+        return true;
+    }
     return false;
 }
 
-bool GameState::monster_move(Monster *entity) {
+bool GameState::monster_move(Monster *entity, const MovePlan *plan) {
     int col = entity->col;
     int row = entity->row;
     relative_array(1, entity->row, entity->col, DUNGEON_HEIGHT, DUNGEON_WIDTH, );
@@ -93,8 +327,8 @@ bool GameState::monster_move(Monster *entity) {
                           {row, left}   ,                {row, right},
                           {bottom, left}, {bottom, col}, {bottom, right}};
 
-    if (entity->erratic && better_rand(1)) {
-        int idx = better_rand(7);
+    if (entity->erratic && better_rand(1, RNG_AI)) {
+        int idx = better_rand(7, RNG_AI);
         move_to(entity, adjacent[idx][0], adjacent[idx][1]);
         return false;
     }
@@ -102,32 +336,46 @@ bool GameState::monster_move(Monster *entity) {
      // get the location this monster is moving to
     Coord target = get_target(entity);
     if (entity->smart) {
-        //first get the correct distance map
-        Distances distance_map;
-        if (entity->tunneling) {
-            distance_map = dijkstra(dungeon, target.row, target.col, _length_tunnel);
-        } else {
-            distance_map = dijkstra(dungeon, target.row, target.col, _length_no_tunnel);
+        // without tunneling a target in another component can never be reached, so just wait
+        if (!entity->tunneling &&
+            dungeon.component[entity->row][entity->col] != dungeon.component[target.row][target.col]) {
+            return false;
         }
-        
-        int lowest = 0;
-        for(int i = 0; i < 8; i++) {
-            int old_distance = distance_map.d[adjacent[lowest][0]][adjacent[lowest][1]];
-            int distance = distance_map.d[adjacent[i][0]][adjacent[i][1]];
-            if (distance < old_distance) {
-                lowest = i;
+
+        int lowest;
+        if (plan && plan->valid && plan->row == entity->row && plan->col == entity->col &&
+            plan->target.row == target.row && plan->target.col == target.col &&
+            plan->terrain_version == terrain_version) {
+            lowest = plan->step;
+        } else if (ai_budget == 0 || ai_spent < std::chrono::microseconds(ai_budget)) {
+            auto start = std::chrono::steady_clock::now();
+            lowest = choose_step(entity, target);
+            ai_spent += std::chrono::steady_clock::now() - start;
+        } else {
+            // out of time until the player's next turn, the search is left for then
+            lowest = fallback_step(entity, target);
+            if (lowest < 0) {
+                return false;
             }
         }
+        entity->last_step = lowest;
         
-        if (dungeon.blocks[adjacent[lowest][0]][adjacent[lowest][1]].type == DungeonBlock::ROCK ||
-            dungeon.blocks[adjacent[lowest][0]][adjacent[lowest][1]].type == DungeonBlock::PILLAR) {
+        if (dungeon.type[adjacent[lowest][0]][adjacent[lowest][1]] == DungeonBlock::ROCK ||
+            dungeon.type[adjacent[lowest][0]][adjacent[lowest][1]] == DungeonBlock::PILLAR) {
+            // a monster that can't tunnel waits rather than wearing down the wall
+            if (!entity->tunneling) {
+                return false;
+            }
             
-            uint8_t hardness = dungeon.blocks[adjacent[lowest][0]][adjacent[lowest][1]].hardness;
+            uint8_t hardness = dungeon.hardness[adjacent[lowest][0]][adjacent[lowest][1]];
             hardness = hardness < 85 ? 0 : hardness - 85;
-            dungeon.blocks[adjacent[lowest][0]][adjacent[lowest][1]].hardness = hardness;
+            dungeon.hardness.mut(adjacent[lowest][0], adjacent[lowest][1]) = hardness;
+            view_changed(adjacent[lowest][0], adjacent[lowest][1]);
+            terrain_version++;
 
             if (hardness == 0) {
-                dungeon.blocks[adjacent[lowest][0]][adjacent[lowest][1]].type = DungeonBlock::HALL;
+                carve_block(&dungeon, adjacent[lowest][0], adjacent[lowest][1]);
+                fov_dirty = true;
                 move_to(entity, adjacent[lowest][0], adjacent[lowest][1]);
             }
         } else {
@@ -148,6 +396,76 @@ bool GameState::monster_move(Monster *entity) {
     return false;
 }
 
+// the index into the 8 neighbors of the step a smart monster takes towards target
+int GameState::choose_step(const Monster *entity, Coord target) const {
+    int col = entity->col;
+    int row = entity->row;
+    relative_array(1, entity->row, entity->col, DUNGEON_HEIGHT, DUNGEON_WIDTH, );
+    int adjacent[8][2] = {{top, left}   , {top, col}   , {top, right},
+                          {row, left}   ,                {row, right},
+                          {bottom, left}, {bottom, col}, {bottom, right}};
+
+    //first get the correct distance map
+    Distances distance_map;
+    if (entity->tunneling) {
+        distance_map = dijkstra(dungeon, target.row, target.col, _length_tunnel);
+    } else {
+        distance_map = dijkstra(dungeon, target.row, target.col, _length_no_tunnel);
+    }
+
+    int lowest = 0;
+    for(int i = 0; i < 8; i++) {
+        int old_distance = distance_map.d[adjacent[lowest][0]][adjacent[lowest][1]];
+        int distance = distance_map.d[adjacent[i][0]][adjacent[i][1]];
+        if (distance < old_distance) {
+            lowest = i;
+        }
+    }
+    return lowest;
+}
+
+// A step for a smart monster that costs no search. The monster keeps going the
+// way its last search pointed while that still brings it closer to the target,
+// and otherwise takes the open neighbor closest to the target. -1 when it is
+// already there or no open neighbor brings it closer, and it waits.
+int GameState::fallback_step(const Monster *entity, Coord target) const {
+    // row and column offsets of the 8 neighbors, in the order steps are numbered
+    static const int OFFSETS[8][2] = {{-1, -1}, {-1, 0}, {-1, 1},
+                                      { 0, -1},          { 0, 1},
+                                      { 1, -1}, { 1, 0}, { 1, 1}};
+    int distance = std::max(abs(target.row - entity->row), abs(target.col - entity->col));
+    if (distance == 0) {
+        return -1;
+    }
+
+    if (entity->last_step >= 0) {
+        int row = entity->row + OFFSETS[entity->last_step][0];
+        int col = entity->col + OFFSETS[entity->last_step][1];
+        uint8_t type = dungeon.type[row][col];
+        if (std::max(abs(target.row - row), abs(target.col - col)) < distance &&
+            (entity->tunneling || (type != DungeonBlock::ROCK && type != DungeonBlock::PILLAR))) {
+            return entity->last_step;
+        }
+    }
+
+    // otherwise the neighbor closest to the target, never through rock unless it can tunnel
+    int best = -1;
+    for(int i = 0; i < 8; i++) {
+        int row = entity->row + OFFSETS[i][0];
+        int col = entity->col + OFFSETS[i][1];
+        uint8_t type = dungeon.type[row][col];
+        if (!entity->tunneling && (type == DungeonBlock::ROCK || type == DungeonBlock::PILLAR)) {
+            continue;
+        }
+        int to_target = std::max(abs(target.row - row), abs(target.col - col));
+        if (to_target < distance) {
+            best = i;
+            distance = to_target;
+        }
+    }
+    return best;
+}
+
 bool GameState::player_move(Player *entity) {
     bool control_mode = true;
     bool debug = false;
@@ -158,6 +476,18 @@ bool GameState::player_move(Player *entity) {
     int view_row = row;
     relative_array(1, entity->row, entity->col, DUNGEON_HEIGHT, DUNGEON_WIDTH, );
 
+    if (bot) {
+        return bot_move(entity);
+    }
+
+    if (!route->empty() || exploring) {
+        if (auto_step(entity)) {
+            return false;
+        }
+        // the route was stopped, show the player why before asking for input
+        print_view(this, view_row, view_col);
+    }
+
     // loop until a movement is actually made
     while (true) {
         int ch = get_input();
@@ -231,6 +561,7 @@ bool GameState::player_move(Player *entity) {
                                 }
                                 break;
                         }
+                        entity->update_stats(dungeon.o_store.get());
                     }
                     break;
                 case 't':
@@ -253,9 +584,10 @@ bool GameState::player_move(Player *entity) {
                         break;
                     }
                     std::swap(entity->carry[open_carry], entity->equipment[o_index]);
+                    entity->update_stats(dungeon.o_store.get());
                     break;
                 case 'd':
-                    if (dungeon.blocks[entity->row][entity->col].object_id != 0) {
+                    if (dungeon.objects[entity->row][entity->col] != 0) {
                         notify("No space to drop", 1);
                         break;
                     }
@@ -266,7 +598,8 @@ bool GameState::player_move(Player *entity) {
                         // error prompt
                         break;
                     }
-                    std::swap(dungeon.blocks[entity->row][entity->col].object_id, entity->carry[o_index]);
+                    dungeon.objects.mut(entity->row, entity->col) = entity->carry[o_index];
+                    entity->carry[o_index] = 0;
                     break;
                 case 'x':
                     print_pc_inventory(&dungeon);
@@ -310,18 +643,31 @@ bool GameState::player_move(Player *entity) {
                      move_to(entity, row, left);
                     return false;
                 case '<':
-                    if (dungeon.blocks[row][col].type == DungeonBlock::UPSTAIRS) {
-                        new_floor();
+                    if (dungeon.type[row][col] == DungeonBlock::UPSTAIRS) {
+                        new_floor(-1);
                         return true;
                     }
                 case '>':
-                    if (dungeon.blocks[row][col].type == DungeonBlock::DOWNSTAIRS) {
-                        new_floor();
+                    if (dungeon.type[row][col] == DungeonBlock::DOWNSTAIRS) {
+                        new_floor(1);
                         return true;
                     }
                 case ' ':
                 case '5':
                     return false;
+                case 'o':
+                    exploring = true;
+                    if (auto_step(entity)) {
+                        return false;
+                    }
+                    break;
+                case 'T':
+                    if (!plan_route(entity, STAIRS)) {
+                        notify("No stairs found yet", 0);
+                    } else if (auto_step(entity)) {
+                        return false;
+                    }
+                    break;
                 case 'L':
                     control_mode = false;
                     break;
@@ -372,83 +718,196 @@ bool GameState::player_move(Player *entity) {
     }
 }
 
-Coord GameState::get_target(Monster *entity) {
-    Entity *player = dungeon.store->get(dungeon.player_id).unwrap();
+// A simple player for soak runs. It fights whatever comes into view, otherwise
+// explores the floor, then travels to the closest down stairs and takes them.
+// Every call takes a turn, even if the bot has nowhere to go.
+bool GameState::bot_move(Player *entity) {
+    const Entity *closest = NULL;
+    int closest_distance = INT_MAX;
+    for(EIdx i = 1; i <= dungeon.store->size(); i++) {
+        const Entity *monster = dungeon.store->peek(i).unwrap();
+        if (i == dungeon.player_id || !monster->alive || !view.visible.get(monster->row, monster->col)) {
+            continue;
+        }
+        int distance = std::max(abs(monster->row - entity->row), abs(monster->col - entity->col));
+        if (distance < closest_distance) {
+            closest = monster;
+            closest_distance = distance;
+        }
+    }
+    if (closest != NULL) {
+        route.mut().clear();
+        exploring = false;
+        int row = entity->row + (closest->row > entity->row) - (closest->row < entity->row);
+        int col = entity->col + (closest->col > entity->col) - (closest->col < entity->col);
+        move_to(entity, row, col);
+        return false;
+    }
 
+    uint8_t type = dungeon.type[entity->row][entity->col];
+    if (route->empty() && !exploring && type == DungeonBlock::DOWNSTAIRS) {
+        new_floor(1);
+        return true;
+    }
 
-    if (entity->telepathic) {
-        return (Coord){.row = player->row, .col = player->col};
+    if (!route->empty() && auto_step(entity)) {
+        return false;
     }
+    exploring = true;
+    if (auto_step(entity)) {
+        return false;
+    }
+    // with nowhere left to go, rest
+    if (plan_route(entity, DOWNSTAIRS)) {
+        auto_step(entity);
+    }
+    return false;
+}
 
-    // check for pc line of sight
-    if (can_see((Coord){.row = entity->row, .col = entity->col},
-                (Coord){.row = player->row, .col = player->col})) {
-        return (Coord){.row = player->row, .col = player->col};
-    } else if (entity->smart) {
-        return (Coord){.row = entity->pc_last_seen[0], .col = entity->pc_last_seen[1]};
-    } else {
-        return (Coord){.row = entity->row, .col = entity->col};
+// Take the next step of the player's route. Returns false without moving when
+// the route is finished or has been stopped.
+bool GameState::auto_step(Player *entity) {
+    if (monster_in_view()) {
+        stop_route("Monster in view");
+        return false;
     }
+    if (route->empty() && (!exploring || !plan_route(entity, UNEXPLORED))) {
+        stop_route(exploring ? "Nothing left to explore" : NULL);
+        return false;
+    }
+
+    Coord next = route->back();
+    route.mut().pop_back();
+    uint8_t type = dungeon.type[next.row][next.col];
+    if (abs(next.row - entity->row) > 1 || abs(next.col - entity->col) > 1 ||
+        type == DungeonBlock::ROCK || type == DungeonBlock::PILLAR || dungeon.entities[next.row][next.col] != 0) {
+        stop_route("Path is blocked");
+        return false;
+    }
+
+    move_to(entity, next.row, next.col);
+    return true;
 }
 
-bool GameState::can_see(Coord a, Coord b) {
-    Coord current = a;
-    int d_row = abs(a.row - b.row);
-    int d_col = -abs(a.col - b.col);
-    int row_dir = a.row < b.row ? 1 : -1;
-    int col_dir = a.col < b.col ? 1 : -1;
-    int error = d_row + d_col;
+// Plan a route over the remembered floor to the closest block that is a goal.
+bool GameState::plan_route(const Player *entity, RouteGoal goal) {
+    Distances distance_map = dijkstra(view, entity->row, entity->col, _length_remembered);
 
-    while(true) {
-        if (dungeon.blocks[current.row][current.col].type == DungeonBlock::ROCK ||
-            dungeon.blocks[current.row][current.col].type == DungeonBlock::PILLAR) {
-            return false;
-        }
+    int best = INT_MAX;
+    Coord target;
+    for(int row = 0; row < DUNGEON_HEIGHT; row++) {
+        for(int col = 0; col < DUNGEON_WIDTH; col++) {
+            int distance = distance_map.d[row][col];
+            if (distance == 0 || distance >= best) {
+                continue;
+            }
 
-        if (current.row == b.row && current.col == b.col) {
-            return true;
+            bool reached;
+            if (goal == UNEXPLORED) {
+                reached = unexplored_neighbor(row, col);
+            } else if (goal == STAIRS) {
+                reached = view.type[row][col] == DungeonBlock::UPSTAIRS || view.type[row][col] == DungeonBlock::DOWNSTAIRS;
+            } else {
+                reached = view.type[row][col] == DungeonBlock::DOWNSTAIRS;
+            }
+            if (reached) {
+                best = distance;
+                target = (Coord){.row = row, .col = col};
+            }
         }
+    }
+    if (best == INT_MAX) {
+        return false;
+    }
 
-        int tmp_error = error * 2;
-        if (tmp_error <= d_row) {
-            error += d_row;
-            current.col += col_dir;
+    // walk back down the distance field, every step is one closer to the player
+    route.mut().clear();
+    Coord at = target;
+    while (distance_map.d[at.row][at.col] != 0) {
+        route.mut().push_back(at);
+        relative_array(1, at.row, at.col, DUNGEON_HEIGHT, DUNGEON_WIDTH, );
+        int adjacent[8][2] = {{top, left}   , {top, at.col}   , {top, right},
+                              {at.row, left}   ,                {at.row, right},
+                              {bottom, left}, {bottom, at.col}, {bottom, right}};
+        for(int i = 0; i < 8; i++) {
+            if (distance_map.d[adjacent[i][0]][adjacent[i][1]] == distance_map.d[at.row][at.col] - 1) {
+                at = (Coord){.row = adjacent[i][0], .col = adjacent[i][1]};
+                break;
+            }
         }
+    }
+    return true;
+}
 
-        if (tmp_error >= d_col) {
-            error += d_col;
-            current.row += row_dir;
+void GameState::stop_route(const char *reason) {
+    if (reason != NULL) {
+        notify(reason, 0);
+    }
+    route.mut().clear();
+    exploring = false;
+}
+
+bool GameState::monster_in_view() {
+    for(EIdx i = 1; i <= dungeon.store->size(); i++) {
+        const Entity *entity = dungeon.store->peek(i).unwrap();
+        if (i != dungeon.player_id && entity->alive && view.visible.get(entity->row, entity->col)) {
+            return true;
         }
     }
+    return false;
+}
+
+bool GameState::unexplored_neighbor(int row, int col) {
+    relative_array(1, row, col, DUNGEON_HEIGHT, DUNGEON_WIDTH, );
+    return !view.explored.get(top, left) || !view.explored.get(top, col) || !view.explored.get(top, right) ||
+        !view.explored.get(row, left) || !view.explored.get(row, right) ||
+        !view.explored.get(bottom, left) || !view.explored.get(bottom, col) || !view.explored.get(bottom, right);
+}
+
+Coord GameState::get_target(Monster *entity) {
+    Coord target = peek_target(entity);
+    if (!entity->telepathic && view.visible.get(entity->row, entity->col)) {
+        entity->pc_last_seen[0] = target.row;
+        entity->pc_last_seen[1] = target.col;
+    }
+    return target;
+}
+
+// the target get_target would pick, without recording where the player was seen
+Coord GameState::peek_target(const Monster *entity) const {
+    const Entity *player = dungeon.store->peek(dungeon.player_id).unwrap();
+
+
+    if (entity->telepathic) {
+        return (Coord){.row = player->row, .col = player->col};
+    }
+
+    // monsters see the player exactly when they stand in the player's field of
+    // view, so no farther than PC_VIEW_RADIUS
+    if (view.visible.get(entity->row, entity->col)) {
+        return (Coord){.row = player->row, .col = player->col};
+    } else if (entity->smart) {
+        return (Coord){.row = entity->pc_last_seen[0], .col = entity->pc_last_seen[1]};
+    } else {
+        return (Coord){.row = entity->row, .col = entity->col};
+    }
 }
 
 void GameState::move_to(Player *player, int to_row, int to_col) {
-    if (dungeon.blocks[to_row][to_col].type == DungeonBlock::ROCK ||
-        dungeon.blocks[to_row][to_col].type == DungeonBlock::PILLAR) {
+    if (dungeon.type[to_row][to_col] == DungeonBlock::ROCK ||
+        dungeon.type[to_row][to_col] == DungeonBlock::PILLAR) {
             return;
     }
     int row = player->row;
     int col = player->col;
 
     // new combat semantics
-    if (dungeon.blocks[to_row][to_col].entity_id != 0 && dungeon.blocks[to_row][to_col].entity_id != player->index) {
-        Entity *entity = dungeon.store->get(dungeon.blocks[to_row][to_col].entity_id).unwrap();
+    if (dungeon.entities[to_row][to_col] != 0 && dungeon.entities[to_row][to_col] != player->index) {
+        Entity *entity = dungeon.store->get(dungeon.entities[to_row][to_col]).unwrap();
         if (!is_player(entity)) {
 
             // the entity is a monster, ATTACK!
-            int damage = 0;
-            if (player->equipment[0] == 0) {
-                // no weapon, do base damage
-                damage += player->base_damage.roll();
-            }
-            // roll all items
-            for(int i = 0; i < 12; i++) {
-                OIdx o_index = player->equipment[i];
-                if (o_index != 0) {
-                    Object *obj = dungeon.o_store->get(o_index).unwrap();
-                    damage += obj->damage_bonus.roll();
-                }
-            }
+            int damage = player->stats.damage.roll(RNG_COMBAT);
             entity->hp -= damage;
             std::string notice = "Did ";
             notice += std::to_string(damage);
@@ -458,7 +917,8 @@ void GameState::move_to(Player *player, int to_row, int to_col) {
             notify(notice.c_str(), 2);
             if (entity->hp < 0) {
                 entity->alive = false;
-                dungeon.blocks[to_row][to_col].entity_id = player->index;
+                dungeon.entities.mut(to_row, to_col) = player->index;
+                dungeon.entities.mut(row, col) = 0;
                 player->row = to_row;
                 player->col = to_col;
                 dungeon.monster_count--;
@@ -467,17 +927,20 @@ void GameState::move_to(Player *player, int to_row, int to_col) {
             // Okay, so this really, REALLY shouldnt happen, so lets just ignore it
         }
     } else {
-        std::swap(dungeon.blocks[to_row][to_col].entity_id, dungeon.blocks[row][col].entity_id);
+        std::swap(dungeon.entities.mut(to_row, to_col), dungeon.entities.mut(row, col));
         player->row = to_row;
         player->col = to_col;
     }
     
     // search for open carry slots
-    if (dungeon.blocks[to_row][to_col].object_id != 0) {
+    if (dungeon.objects[to_row][to_col] != 0) {
         for(int i = 0; i < 10; i++) {
             if (player->carry[i] == 0) {
-                player->carry[i] = dungeon.blocks[to_row][to_col].object_id;
-                dungeon.blocks[to_row][to_col].object_id = 0;
+                player->carry[i] = dungeon.objects[to_row][to_col];
+                dungeon.objects.mut(to_row, to_col) = 0;
+                if (!route->empty() || exploring) {
+                    stop_route("Picked up an item");
+                }
                 break;
             }
         }
@@ -485,19 +948,19 @@ void GameState::move_to(Player *player, int to_row, int to_col) {
 }
 
 void GameState::move_to(Monster *monster, int to_row, int to_col) {
-    if (dungeon.blocks[to_row][to_col].type == DungeonBlock::ROCK ||
-        dungeon.blocks[to_row][to_col].type == DungeonBlock::PILLAR) {
+    if (dungeon.type[to_row][to_col] == DungeonBlock::ROCK ||
+        dungeon.type[to_row][to_col] == DungeonBlock::PILLAR) {
             return;
     }
     int row = monster->row;
     int col = monster->col;
 
     // check if something is in our way
-    if (dungeon.blocks[to_row][to_col].entity_id != 0 && dungeon.blocks[to_row][to_col].entity_id != monster->index) {
-        Entity *entity = dungeon.store->get(dungeon.blocks[to_row][to_col].entity_id).unwrap();
+    if (dungeon.entities[to_row][to_col] != 0 && dungeon.entities[to_row][to_col] != monster->index) {
+        Entity *entity = dungeon.store->get(dungeon.entities[to_row][to_col]).unwrap();
         if (is_player(entity)) {
             // the entity is a player, ATTACK!
-            int damage = monster->damage.roll();
+            int damage = dungeon.store->traits(monster).damage.roll(RNG_COMBAT);
             entity->hp -= damage;
             std::string notice = "Attacked for ";
             notice += std::to_string(damage);
@@ -507,19 +970,20 @@ void GameState::move_to(Monster *monster, int to_row, int to_col) {
             notify(notice.c_str(), 1);
             if (entity->hp < 0) {
                 entity->alive = false;
-                dungeon.blocks[to_row][to_col].entity_id = monster->index;
+                dungeon.entities.mut(to_row, to_col) = monster->index;
+                dungeon.entities.mut(row, col) = 0;
                 monster->row = to_row;
                 monster->col = to_col;
             }
         } else {
-            std::swap(dungeon.blocks[to_row][to_col].entity_id, dungeon.blocks[row][col].entity_id);
+            std::swap(dungeon.entities.mut(to_row, to_col), dungeon.entities.mut(row, col));
             monster->row = to_row;
             monster->col = to_col;
             entity->row = row;
             entity->col = col;
         }
     } else {
-        std::swap(dungeon.blocks[to_row][to_col].entity_id, dungeon.blocks[row][col].entity_id);
+        std::swap(dungeon.entities.mut(to_row, to_col), dungeon.entities.mut(row, col));
             monster->row = to_row;
             monster->col = to_col;
     }
@@ -527,8 +991,19 @@ void GameState::move_to(Monster *monster, int to_row, int to_col) {
 
 static int _length_no_tunnel(const Dungeon& dungeon, Coordinate *from, Coordinate *to) {
     (void)(from);
-    DungeonBlock b_to = dungeon.blocks[to->row][to->col];
-    if (b_to.type == DungeonBlock::ROCK || b_to.type == DungeonBlock::PILLAR) {
+    uint8_t type = dungeon.type[to->row][to->col];
+    if (type == DungeonBlock::ROCK || type == DungeonBlock::PILLAR) {
+        return INT_MAX;
+    } else {
+        return 1;
+    }
+}
+
+// the player only plans through terrain they remember being open
+static int _length_remembered(const View& view, Coordinate *from, Coordinate *to) {
+    (void)(from);
+    uint8_t type = view.type[to->row][to->col];
+    if (type == DungeonBlock::ROCK || type == DungeonBlock::PILLAR) {
         return INT_MAX;
     } else {
         return 1;
@@ -537,13 +1012,13 @@ static int _length_no_tunnel(const Dungeon& dungeon, Coordinate *from, Coordinat
 
 static int _length_tunnel(const Dungeon& dungeon, Coordinate *from, Coordinate *to) {
     (void)(from);
-    DungeonBlock b_to = dungeon.blocks[to->row][to->col];
-    if (b_to.type == DungeonBlock::ROCK || b_to.type == DungeonBlock::PILLAR) {
-        if(b_to.immutable) {
+    uint8_t type = dungeon.type[to->row][to->col];
+    if (type == DungeonBlock::ROCK || type == DungeonBlock::PILLAR) {
+        if(dungeon.immutable.get(to->row, to->col)) {
             return INT_MAX;
         }
 
-        uint8_t hardness = b_to.hardness;
+        uint8_t hardness = dungeon.hardness[to->row][to->col];
         //printf("hardness %d\n", hardness);
         if (hardness < HARDNESS_TIER_1) {
             return 1;
@@ -561,27 +1036,49 @@ static int _length_tunnel(const Dungeon& dungeon, Coordinate *from, Coordinate *
     }
 }
 
+void GameState::view_changed(int row, int col) {
+    if (view.visible.get(row, col)) {
+        view_dirty.push_back((Coord){.row = row, .col = col});
+    }
+}
+
 void GameState::update_player_view() {
-    Entity *player = dungeon.store->get(dungeon.player_id).unwrap();
-    int p_row = player->row;
-    int p_col = player->col;
+    if (fov_dirty) {
+        const Entity *player = dungeon.store->peek(dungeon.player_id).unwrap();
+        int p_row = player->row;
+        int p_col = player->col;
 
-    int l_row_bound = p_row - 4 < 0 ? 0 : p_row - 4;
-    int u_row_bound = p_row + 5 > DUNGEON_HEIGHT ? DUNGEON_HEIGHT : p_row + 5;
+        compute_fov(&dungeon, p_row, p_col, PC_VIEW_RADIUS, &view.visible);
+        fov_dirty = false;
 
-    int l_col_bound = p_col - 4 < 0 ? 0 : p_col - 4;
-    int u_col_bound = p_col + 5 > DUNGEON_WIDTH ? DUNGEON_WIDTH : p_col + 5;
+        int l_row_bound = p_row - PC_VIEW_RADIUS < 0 ? 0 : p_row - PC_VIEW_RADIUS;
+        int u_row_bound = p_row + PC_VIEW_RADIUS + 1 > DUNGEON_HEIGHT ? DUNGEON_HEIGHT : p_row + PC_VIEW_RADIUS + 1;
 
-    // clear out old entities
-    for(int row = 0; row < DUNGEON_HEIGHT; row++) {
-        for(int col = 0; col < DUNGEON_WIDTH; col++) {
-            view.blocks[row][col].entity_id = 0;
+        int l_col_bound = p_col - PC_VIEW_RADIUS < 0 ? 0 : p_col - PC_VIEW_RADIUS;
+        int u_col_bound = p_col + PC_VIEW_RADIUS + 1 > DUNGEON_WIDTH ? DUNGEON_WIDTH : p_col + PC_VIEW_RADIUS + 1;
+
+        for(int row = l_row_bound; row < u_row_bound; row++) {
+            for(int col = l_col_bound; col < u_col_bound; col++) {
+                if (view.visible.get(row, col)) {
+                    view_dirty.push_back((Coord){.row = row, .col = col});
+                }
+            }
         }
     }
 
-    for(int row = l_row_bound; row < u_row_bound; row++) {
-        for(int col = l_col_bound; col < u_col_bound; col++) {
-            view.blocks[row][col] = dungeon.blocks[row][col];
+    // remember the terrain of blocks in view that changed since the last update
+    for(Coord coord : view_dirty) {
+        if (view.visible.get(coord.row, coord.col)) {
+            uint8_t type = dungeon.type[coord.row][coord.col];
+            bool was_open = view.type[coord.row][coord.col] != DungeonBlock::ROCK;
+            bool open = type != DungeonBlock::ROCK;
+            if (open != was_open) {
+                set_open_neighbor(view.open_neighbors, coord.row, coord.col, open);
+            }
+            view.type.mut(coord.row, coord.col) = type;
+            view.explored.set(coord.row, coord.col);
+            view.hardness.mut(coord.row, coord.col) = dungeon.hardness[coord.row][coord.col];
         }
     }
-}
\ No newline at end of file
+    view_dirty.clear();
+}
@@ -1,14 +1,58 @@
 #ifndef LOOP_H
 #define LOOP_H
 
-#include <collections/heap.h>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <future>
+
+#include <collections/timing_wheel.h>
+#include <collections/cow.h>
+#include <collections/cow_grid.h>
 #include <dungeon/entities.h>
 #include <dungeon/dungeon.h>
+#include <dungeon/fov.h>
+
+// How far the player can see. Sight is shared, so this also caps how far
+// away a monster can see the player from. Line of sight used to be unbounded,
+// so monsters across a long open room no longer notice the player.
+#define PC_VIEW_RADIUS 15
+
+// Monsters sleep outside of the event queue until the player comes within the
+// wake radius or enters their room, and fall back asleep beyond the sleep
+// radius. Telepathic monsters always know where the player is and never sleep.
+#define MONSTER_WAKE_RADIUS 20
+#define MONSTER_SLEEP_RADIUS 30
+
+// how many floors the player has left are kept to return to
+#define FLOOR_CACHE_SIZE 8
 
+// Microseconds monsters may spend searching for paths between two turns of
+// the player. Searches are not spread over later frames: monsters that run
+// over move without a search until the player's next turn refills the budget.
+#define AI_FRAME_BUDGET 10000
+
+// What the player remembers of the floor. Only terrain is remembered, entities
+// and objects are looked up in the dungeon when the block is drawn.
 typedef struct {
-    DungeonBlock blocks[DUNGEON_HEIGHT][DUNGEON_WIDTH];
+    // unexplored blocks are remembered as rock
+    CowGrid<uint8_t, DUNGEON_HEIGHT, DUNGEON_WIDTH> type;
+    CowGrid<uint8_t, DUNGEON_HEIGHT, DUNGEON_WIDTH> hardness;
+    // open neighbor mask of the remembered terrain
+    OpenNeighbors open_neighbors;
+    // blocks in the player's field of view
+    VisibilityMap visible;
+    // blocks that have been in the player's field of view on this floor
+    VisibilityMap explored;
 } View;
 
+// A floor the player left, kept as it was so that it can be returned to. It
+// is never written once left, so snapshots of the game share it.
+typedef struct {
+    Dungeon dungeon;
+    View view;
+} VisitedFloor;
+
 typedef struct {
     int turn;
     EIdx entity_id;
@@ -22,22 +66,112 @@ typedef struct {
     int col;
 } Coord;
 
+// A smart monster's step worked out ahead of its turn. It is only used if the
+// monster, its target and the terrain are unchanged when the turn comes.
+typedef struct {
+    bool valid;
+    int row;
+    int col;
+    Coord target;
+    int terrain_version;
+    int step;
+} MovePlan;
+
 class GameState {
-    Heap<Event> event_queue;
+    // turns advance by at most 1000 per action, well inside the wheel's 1024 slots
+    Cow<TimingWheel<Event>> event_queue;
+
+    // bumped whenever a monster changes the terrain, invalidating plans made before
+    int terrain_version;
+    // the turn of the event being run
+    int current_turn;
+    // time spent in path searches since the player last acted
+    std::chrono::steady_clock::duration ai_spent;
+    // the floor the stairs lead to, generated on another thread while this one is played
+    std::shared_future<Dungeon> next_floor;
+    // floors left by the player by depth, at most FLOOR_CACHE_SIZE of them
+    std::map<int, std::shared_ptr<const VisitedFloor>> visited;
 
-    bool monster_move(Monster *entity);
+    // what a route leads to
+    enum RouteGoal {
+        UNEXPLORED,
+        STAIRS,
+        DOWNSTAIRS
+    };
+    // monsters that are not in the event queue
+    Cow<std::vector<EIdx>> sleeping;
+    // Steps left on the player's explore or travel route, the next step is at
+    // the back. While a route is active the player moves without input.
+    Cow<std::vector<Coord>> route;
+    // plan a new route to unexplored blocks whenever the current one runs out
+    bool exploring;
+
+    void init_floor();
+    int action_delay(const Entity *entity);
+    bool perceives_player(const Monster *entity, int radius);
+    void wake_monsters();
+    void run_event(Event event, const MovePlan *plan);
+    void tick_batch();
+    void plan_moves(const std::vector<Event>& batch, std::vector<MovePlan>& plans);
+    bool monster_move(Monster *entity, const MovePlan *plan);
+    int choose_step(const Monster *entity, Coord target) const;
+    int fallback_step(const Monster *entity, Coord target) const;
     bool player_move(Player *entity);
+    bool bot_move(Player *entity);
+    bool auto_step(Player *entity);
+    bool plan_route(const Player *entity, RouteGoal goal);
+    void stop_route(const char *reason);
+    bool monster_in_view();
+    bool unexplored_neighbor(int row, int col);
     void move_to(Player *entity, int row, int col);
     void move_to(Monster *entity, int row, int col);
     Coord get_target(Monster *entity);
-    bool can_see(Coord a, Coord b);
-    void new_floor();
+    Coord peek_target(const Monster *entity) const;
+    void new_floor(int direction);
+    void pregenerate_floor();
     void update_player_view();
+    void view_changed(int row, int col);
     public:
         Dungeon dungeon;
         View view;
+        // the field of view is recomputed when this is set
+        bool fov_dirty;
+        // blocks in view whose terrain changed since the last update
+        std::vector<Coord> view_dirty;
+        // with more than one thread, monsters acting on the same turn plan their moves in parallel
+        int ai_threads;
+        // microseconds of path searching allowed between player turns, 0 for no limit
+        int ai_budget;
+        // the player is played by bot_move instead of reading input
+        bool bot;
+        // floors generated so far, including the first
+        int floors;
+        // how many floors below the first the player is, negative above it
+        int depth;
         GameState(Dungeon dungeon);
+        // A copy of the game to come back to later. It shares the dungeon, the
+        // event queue and what the player remembers with this game, and
+        // either side copies a piece only when it first writes to it.
+        GameState snapshot() const;
+        // Go back to a snapshot by sharing its pieces again. The pieces
+        // written since the snapshot are the only copies, and they are dropped.
+        // If the floor being generated ahead is no longer shared with the
+        // snapshot, this waits for it to finish.
+        void restore(const GameState& snapshot);
         bool tick();
+        // true when the next event is the player's, so the next tick will wait on input
+        bool awaiting_input();
+};
+
+// Decides when the main loop redraws. The screen is drawn before the player is
+// prompted, and otherwise at most once per frame when animating monster turns.
+class RenderScheduler {
+    bool animate;
+    std::chrono::steady_clock::duration frame_time;
+    std::chrono::steady_clock::time_point last_frame;
+    public:
+        RenderScheduler(bool animate, int frames_per_second);
+        bool should_render(GameState *state);
 };
 
 
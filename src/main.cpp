@@ -7,17 +7,17 @@
 #include <fstream>
 #include <vector>
 #include <memory>
+#include <thread>
 
 #include <dungeon/dungeon.h>
 #include <util/distance.h>
 #include <util/util.h>
 #include <loop.h>
 #include <io.h>
+#include <soak.h>
 
 Options parse_args(int argc, char *argv[]);
 int main(int argc, char *argv[]) {
-    srand(time(NULL));
-    
     std::string monster_path = getenv("HOME");
     monster_path += "/.rlg327/";
     mkdir(monster_path.c_str(), 0777);
@@ -33,6 +33,7 @@ int main(int argc, char *argv[]) {
     auto object_descriptions = load_object_descriptions(object_file_stream);
 
     Options options = parse_args(argc, argv);
+    seed_rand(options.seed);
     options.monster_pool = monster_descriptions;
     options.object_pool = object_descriptions;
     options.room_tries = 1000;
@@ -41,21 +42,31 @@ int main(int argc, char *argv[]) {
     options.windiness = 30;
     options.max_maze_size = 2000;
     options.imperfection = 2000;
+
+    if (options.soak_games > 0) {
+        if (options.ai_budget < 0) {
+            options.ai_budget = 0;
+        }
+        SoakStats stats = run_soak(&options, options.soak_games, options.soak_workers, options.seed);
+        print_soak_stats(stats, options.soak_workers, options.seed);
+        return 0;
+    }
     
     init_screen(options.full_size);
-    Dungeon dungeon;
-    if (options.load) {
-        dungeon = load_dungeon(options.path);
-    } else {
-        dungeon = create_dungeon(&options);
-    }
+    Dungeon dungeon = options.load ? load_dungeon(options.path) : create_dungeon(&options, create_object_store(&options));
+    dungeon.params = &options;
 
-    GameState* state = new GameState(dungeon);
+    GameState* state = new GameState(std::move(dungeon));
+    state->ai_threads = options.ai_threads;
+    state->ai_budget = options.ai_budget < 0 ? AI_FRAME_BUDGET : options.ai_budget;
+    RenderScheduler render(options.animate, 30);
     while (1) {
-        Entity *player = state->dungeon.store->get(state->dungeon.player_id).unwrap();
-        print_view(state, player->row, player->col);
+        if (render.should_render(state)) {
+            const Entity *player = state->dungeon.store->peek(state->dungeon.player_id).unwrap();
+            print_view(state, player->row, player->col);
+        }
         state->tick();
-        if (!state->dungeon.store->get(state->dungeon.player_id).unwrap()->alive) {
+        if (!state->dungeon.store->peek(state->dungeon.player_id).unwrap()->alive) {
             std::cout <<"Player loses :(" << std::endl;
             break;
         } 
@@ -73,6 +84,15 @@ Options parse_args(int argc, char *argv[]) {
     Options options;
     options.save = false;
     options.load = false;
+    options.animate = false;
+    options.ai_threads = 1;
+    // left to the mode, soak runs only limit search time when asked to so that they repeat exactly
+    options.ai_budget = -1;
+    options.soak_games = 0;
+    options.soak_workers = std::max(1u, std::thread::hardware_concurrency());
+    options.full_size = false;
+    options.seed = time(NULL);
+    options.monsters = 10;
 
     strcpy(options.path, getenv("HOME"));
     strcat(options.path, "/.rlg327/");
@@ -83,11 +103,18 @@ Options parse_args(int argc, char *argv[]) {
                                      {"load", no_argument, &options.load, true},
                                      {"path", required_argument, NULL, 'p'},
                                      {"nummon", required_argument, NULL, 'n'},
-                                     {"full", no_argument, &options.full_size, true}};
+                                     {"full", no_argument, &options.full_size, true},
+                                     {"animate", no_argument, &options.animate, true},
+                                     {"threads", required_argument, NULL, 't'},
+                                     {"ai-budget", required_argument, NULL, 'b'},
+                                     {"seed", required_argument, NULL, 'r'},
+                                     {"soak", required_argument, NULL, 'S'},
+                                     {"workers", required_argument, NULL, 'w'},
+                                     {0, 0, 0, 0}};
     int option_index = 0;
 
     int c;
-    while((c = getopt_long(argc, argv, "slfp:n:", long_options, &option_index)) != -1) {
+    while((c = getopt_long(argc, argv, "slfap:n:t:b:r:S:w:", long_options, &option_index)) != -1) {
         switch (c) {
             case 's':
                 options.save = true;
@@ -104,6 +131,24 @@ Options parse_args(int argc, char *argv[]) {
             case 'f':
                 options.full_size = true;
                 break;
+            case 'a':
+                options.animate = true;
+                break;
+            case 't':
+                options.ai_threads = parse_int(optarg).expect("threads argument must be an integer");
+                break;
+            case 'b':
+                options.ai_budget = parse_int(optarg).expect("ai-budget argument must be an integer");
+                break;
+            case 'r':
+                options.seed = parse_int(optarg).expect("seed argument must be an integer");
+                break;
+            case 'S':
+                options.soak_games = parse_int(optarg).expect("soak argument must be an integer");
+                break;
+            case 'w':
+                options.soak_workers = parse_int(optarg).expect("workers argument must be an integer");
+                break;
             default:
                 break;
         }
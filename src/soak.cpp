@@ -0,0 +1,85 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include <soak.h>
+#include <loop.h>
+#include <util/util.h>
+
+static void _play_game(Options *options, uint64_t seed, SoakStats *stats);
+
+SoakStats run_soak(Options *options, int games, int workers, uint64_t first_seed) {
+    SoakStats total = {};
+    std::mutex total_lock;
+    std::atomic<int> next_game(0);
+
+    // workers take games from a shared counter and only touch the totals when they finish
+    auto worker = [&]() {
+        SoakStats stats = {};
+        int game;
+        while ((game = next_game++) < games) {
+            _play_game(options, first_seed + game, &stats);
+        }
+
+        std::lock_guard<std::mutex> guard(total_lock);
+        total.games += stats.games;
+        total.deaths += stats.deaths;
+        total.floors += stats.floors;
+        total.ticks += stats.ticks;
+        total.busy_seconds += stats.busy_seconds;
+        total.worst_tick_seconds = std::max(total.worst_tick_seconds, stats.worst_tick_seconds);
+    };
+
+    std::vector<std::thread> threads;
+    for(int i = 1; i < workers; i++) {
+        threads.push_back(std::thread(worker));
+    }
+    worker();
+    for(std::thread& t : threads) {
+        t.join();
+    }
+    return total;
+}
+
+void print_soak_stats(const SoakStats& stats, int workers, uint64_t first_seed) {
+    printf("games: %ld on %d workers, seeds from %llu\n", stats.games, workers, (unsigned long long)first_seed);
+    printf("deaths: %ld\n", stats.deaths);
+    printf("floors: %ld\n", stats.floors);
+    printf("ticks: %ld\n", stats.ticks);
+    printf("ticks/sec per core: %.0f\n", stats.busy_seconds > 0 ? stats.ticks / stats.busy_seconds : 0.0);
+    printf("worst tick: %.3f ms\n", stats.worst_tick_seconds * 1000);
+}
+
+static void _play_game(Options *options, uint64_t seed, SoakStats *stats) {
+    auto start = std::chrono::steady_clock::now();
+    seed_rand(seed);
+    GameState *state = new GameState(create_dungeon(options, create_object_store(options)));
+    state->bot = true;
+    state->ai_threads = options->ai_threads;
+    state->ai_budget = options->ai_budget;
+
+    long ticks = 0;
+    while (ticks < SOAK_MAX_TICKS && state->dungeon.store->peek(state->dungeon.player_id).unwrap()->alive) {
+        auto tick_start = std::chrono::steady_clock::now();
+        state->tick();
+        std::chrono::duration<double> tick_time = std::chrono::steady_clock::now() - tick_start;
+        stats->worst_tick_seconds = std::max(stats->worst_tick_seconds, tick_time.count());
+        ticks++;
+    }
+
+    stats->games++;
+    stats->ticks += ticks;
+    stats->floors += state->floors;
+    if (!state->dungeon.store->peek(state->dungeon.player_id).unwrap()->alive) {
+        stats->deaths++;
+    }
+
+    destroy_state(state);
+    delete state;
+    std::chrono::duration<double> game_time = std::chrono::steady_clock::now() - start;
+    stats->busy_seconds += game_time.count();
+}
@@ -0,0 +1,25 @@
+#ifndef SOAK_H
+#define SOAK_H
+
+#include <dungeon/dungeon.h>
+
+// a game that is still going after this many ticks is stopped and counted as survived
+#define SOAK_MAX_TICKS 200000
+
+typedef struct {
+    long games;
+    long deaths;
+    long floors;
+    long ticks;
+    // time spent running games, summed over all workers
+    double busy_seconds;
+    double worst_tick_seconds;
+} SoakStats;
+
+// Play games headless with the bot player on a pool of worker threads. Game i
+// is seeded with first_seed + i, so a run can be repeated exactly.
+SoakStats run_soak(Options *options, int games, int workers, uint64_t first_seed);
+
+void print_soak_stats(const SoakStats& stats, int workers, uint64_t first_seed);
+
+#endif
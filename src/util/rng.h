@@ -0,0 +1,90 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <cstdint>
+
+// Separate streams of random numbers, so that drawing from one never changes
+// what another produces. A fight going differently does not change what the
+// next floor looks like.
+enum RngStream {
+    // floor generation, including the monsters and objects placed on it
+    RNG_DUNGEON,
+    // damage rolls
+    RNG_COMBAT,
+    // monster decisions
+    RNG_AI,
+    RNG_STREAMS
+};
+
+// the splitmix64 output function, which scrambles every input bit into every output bit
+inline uint64_t splitmix64(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+// Counter based random numbers. The value for a key never depends on which
+// keys were drawn before it or on which thread, so work that draws them can
+// run in any order. A key is a seed plus the phase of work and the cell the
+// value is for.
+inline uint64_t keyed_rand(uint64_t seed, uint32_t phase, int row, int col) {
+    uint64_t counter = ((uint64_t)phase << 40) | ((uint64_t)(uint32_t)row << 20) | (uint32_t)col;
+    return splitmix64(seed + (counter + 1) * 0x9e3779b97f4a7c15);
+}
+
+// keyed_rand scaled into [0, limit]. There is no rejection step, since that
+// would need more than one value per key, but for the small ranges used the
+// bias is below one part in a million.
+inline int keyed_rand(uint64_t seed, uint32_t phase, int row, int col, int limit) {
+    return ((keyed_rand(seed, phase, row, col) >> 32) * ((uint64_t)limit + 1)) >> 32;
+}
+
+// xoshiro256**, a small and fast generator with 256 bits of state
+class Rng {
+    uint64_t state[4];
+
+    static uint64_t rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+    public:
+        // An all zero state only ever produces zeros, which would leave
+        // bounded rejecting forever, so a generator is usable before it is seeded.
+        Rng() {
+            seed(0);
+        }
+        // the state is filled from seed with splitmix64, which never leaves it all zero
+        void seed(uint64_t seed) {
+            for(int i = 0; i < 4; i++) {
+                seed += 0x9e3779b97f4a7c15;
+                state[i] = splitmix64(seed);
+            }
+        }
+        uint64_t next() {
+            uint64_t result = rotl(state[1] * 5, 7) * 9;
+            uint64_t t = state[1] << 17;
+            state[2] ^= state[0];
+            state[3] ^= state[1];
+            state[1] ^= state[2];
+            state[0] ^= state[3];
+            state[2] ^= t;
+            state[3] = rotl(state[3], 45);
+            return result;
+        }
+        // A uniform number in [0, range), by Lemire's multiply and shift. The
+        // few products that would bias the result are rejected, which needs a
+        // division only when the first try lands in the low range.
+        uint32_t bounded(uint32_t range) {
+            uint64_t product = (next() >> 32) * range;
+            uint32_t low = (uint32_t)product;
+            if (low < range) {
+                uint32_t threshold = -range % range;
+                while (low < threshold) {
+                    product = (next() >> 32) * range;
+                    low = (uint32_t)product;
+                }
+            }
+            return product >> 32;
+        }
+};
+
+#endif
@@ -24,30 +24,31 @@ Result<int, IntParseError> parse_int(char* str) {
     return Result<int, IntParseError>((int)large);
 }
 
-int better_rand(int limit) {
-unsigned long
-    // max <= RAND_MAX < ULONG_MAX, so this is okay.
-    num_bins = (unsigned long) limit + 1,
-    num_rand = (unsigned long) RAND_MAX + 1,
-    bin_size = num_rand / num_bins,
-    defect   = num_rand % num_bins;
-
-  long x;
-  do {
-   x = random();
-  }
-  // This is carefully written not to overflow
-  while (num_rand - defect <= (unsigned long)x);
-
-  // Truncated division is intentional
-  return x/bin_size;
+thread_local Rng rng_streams[RNG_STREAMS];
+
+void seed_rand(uint64_t seed) {
+    for(int i = 0; i < RNG_STREAMS; i++) {
+        rng_streams[i].seed(seed * RNG_STREAMS + i);
+    }
 }
 
 bool Dice::parse_str(std::string const& str) {
     auto ret = sscanf(str.c_str(), "%d+%dd%d", &base, &num, &sides);
+    set(base, num, sides);
     return ret == 3;
 }
 
+void Dice::set(int base, int num, int sides) {
+    this->base = base;
+    this->num = num;
+    this->sides = sides;
+    if (num > 1 && sides > 1 && (long)num * (sides - 1) + 1 <= DICE_TABLE_MAX) {
+        table = std::make_shared<const DiceTable>(num, sides);
+    } else {
+        table.reset();
+    }
+}
+
 std::string Dice::print() {
     std::string ret = std::to_string(base);
     ret += "+";
@@ -57,13 +58,105 @@ std::string Dice::print() {
     return ret;
 }
 
-int Dice::roll() {
+int Dice::roll(RngStream stream) const {
+    if (table) {
+        return base + table->sample(stream);
+    }
+
     int res = base;
     for (int i = 0; i < num; i++) {
-        res += better_rand(sides - 1) + 1;
+        res += better_rand(sides - 1, stream) + 1;
     }
 
     return res;
 }
 
-Dice::Dice() {}
\ No newline at end of file
+Dice::Dice() {}
+
+DiceTable::DiceTable(int num, int sides) {
+    this->num = num;
+    int sums = num * (sides - 1) + 1;
+
+    // distribution of the sum less num, adding one die at a time with a running window
+    std::vector<double> chance(sums, 0.0);
+    chance[0] = 1.0;
+    for(int die = 1; die <= num; die++) {
+        int reach = die * (sides - 1);
+        double window = 0.0;
+        std::vector<double> next(sums, 0.0);
+        for(int sum = 0; sum <= reach; sum++) {
+            window += chance[sum];
+            if (sum >= sides) {
+                window -= chance[sum - sides];
+            }
+            next[sum] = window / sides;
+        }
+        chance.swap(next);
+    }
+
+    // Vose's method: columns short of an even share are topped up by one that is over
+    threshold.assign(sums, (uint64_t)1 << 32);
+    alias.resize(sums);
+    std::vector<int> small;
+    std::vector<int> large;
+    for(int i = 0; i < sums; i++) {
+        alias[i] = i;
+        chance[i] *= sums;
+        if (chance[i] < 1.0) {
+            small.push_back(i);
+        } else {
+            large.push_back(i);
+        }
+    }
+    while (!small.empty() && !large.empty()) {
+        int under = small.back();
+        small.pop_back();
+        int over = large.back();
+
+        threshold[under] = (uint64_t)(chance[under] * 4294967296.0);
+        alias[under] = over;
+        chance[over] -= 1.0 - chance[under];
+        if (chance[over] < 1.0) {
+            large.pop_back();
+            small.push_back(over);
+        }
+    }
+}
+
+int DiceTable::sample(RngStream stream) const {
+    int column = better_rand(threshold.size() - 1, stream);
+    if ((rng_streams[stream].next() >> 32) < threshold[column]) {
+        return num + column;
+    }
+    return num + alias[column];
+}
+
+DicePool::DicePool() {
+    base = 0;
+}
+
+void DicePool::add(const Dice& dice) {
+    base += dice.base;
+    if (dice.num <= 0 || dice.sides <= 0) {
+        return;
+    }
+
+    for(auto& group : this->dice) {
+        if (group.sides == dice.sides) {
+            group.set(0, group.num + dice.num, group.sides);
+            return;
+        }
+    }
+    Dice group;
+    group.set(0, dice.num, dice.sides);
+    this->dice.push_back(group);
+}
+
+int DicePool::roll(RngStream stream) const {
+    int res = base;
+    for(auto& group : dice) {
+        res += group.roll(stream);
+    }
+
+    return res;
+}
\ No newline at end of file
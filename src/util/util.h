@@ -3,6 +3,12 @@
 
 #include <string>
 #include <iostream>
+#include <vector>
+#include <utility>
+#include <memory>
+#include <cstdint>
+
+#include <util/rng.h>
 typedef struct {} Unit;
 Unit unit();
 
@@ -59,17 +65,57 @@ typedef enum  {
 
 Result<int, IntParseError> parse_int(char* str);
 
-int better_rand(int limit);
+// each thread has its own streams so games running side by side stay independent
+extern thread_local Rng rng_streams[RNG_STREAMS];
+
+// a uniform number in [0, limit] from one of the calling thread's streams
+inline int better_rand(int limit, RngStream stream = RNG_DUNGEON) {
+    return rng_streams[stream].bounded((uint32_t)limit + 1);
+}
+
+// seed all of the calling thread's streams from one seed
+void seed_rand(uint64_t seed);
+
+// dice with more possible sums than this are rolled one die at a time
+#define DICE_TABLE_MAX 4096
+
+// Walker's alias table over the sums of num dice with sides sides, so that a
+// sum is sampled with two draws however many dice there are.
+class DiceTable {
+    int num;
+    // chance out of 2^32 that a column keeps its own sum rather than its alias
+    std::vector<uint64_t> threshold;
+    std::vector<int> alias;
+    public:
+        DiceTable(int num, int sides);
+        // the sum of the dice, between num and num * sides
+        int sample(RngStream stream) const;
+};
 
 class Dice {
+    // shared by copies, only built for more than one die with few enough sums
+    std::shared_ptr<const DiceTable> table;
     public:
         int base;
         int num;
         int sides;
         Dice();
-        int roll();
+        void set(int base, int num, int sides);
+        int roll(RngStream stream = RNG_DUNGEON) const;
         bool parse_str(std::string const& str);
         std::string print();
 };
 
+// A sum of several dice expressions merged into one base and a group of dice
+// for each number of sides, so rolling does not revisit every expression.
+class DicePool {
+    public:
+        int base;
+        // one group per number of sides, each with a base of 0
+        std::vector<Dice> dice;
+        DicePool();
+        void add(const Dice& dice);
+        int roll(RngStream stream = RNG_DUNGEON) const;
+};
+
 #endif
\ No newline at end of file